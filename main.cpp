@@ -2,7 +2,7 @@
 #include <iostream>
 #include <csignal>
 #include <memory>
-#include "src/terminal/Terminal.h"
+#include "src/Terminal/Terminal.h"
 
 using namespace std;
 using namespace classes::server_side;
@@ -14,9 +14,14 @@ namespace terminal {
                 "1:ss/setup-server|-sn %s/--serverName %s",
                 "1:sd/shutdown|",
                 "1:sl/show-log|",
+                "1:sst/server-stats|",
+                "1:an/announce|-m %s/--message %s",
+                "1:dur/durability|-m %i/--mode %i",
+                "1:snap/snapshot|",
                 "3:ccr/change-chat-room|-i %i/--roomID %i,-n %s/--roomName %s",
                 "3:msgin/messageIn|-i %i/--roomID %i,-n %s/--roomName %s|-mc %s/--messageContent %s",
                 "5:msg/message|-m %s/--message %s",
+                "5:tp/typing|-s %i/--state %i",
                 "2:li/login|-i %i/--ID %i|-key %s/--loginKey %s|-a %s/--address %s",
                 "3:lo/logout|",
                 "3:mcr/make-chat-room|-n %s/--name %s|-i %i[]/--clientIDs %i[]",
@@ -3,6 +3,9 @@
 #include <mutex>
 #include <iostream>
 #include "../classes/client_side/ServerConnection.h"
+#include "../classes/server_side/OutboundQueue.h"
+#include "../classes/server_side/util/SlabPool.h"
+#include "../classes/server_side/util/StringTable.h"
 
 using namespace terminal::InstructionInterpreter;
 
@@ -212,10 +215,8 @@ namespace terminal {
                 return;
             if (Accounts.empty())
                 return;
-            stringstream ss;
-            ss << Accounts[0].ID << " " << Accounts[0].ConnectionKey;
             auto resp = ServerConn->Request(ServerAction(classes::general::ServerActionType::LogoutClient, {},
-                                                         ss.str()), classes::client_side::ExpectStatus::RegularInform);
+                                                         ""), classes::client_side::ExpectStatus::RegularInform);
             cout << resp.Serialize() << endl;
             PopContext();
         } else if (curName == "mcr") {
@@ -231,7 +232,7 @@ namespace terminal {
                     roomName = any_cast<string>(cur.Value);
                 else
                     ids = any_cast<vector<unsigned long long>>(cur.Value);
-            ss << Accounts[0].ID << " " << Accounts[0].ConnectionKey << " " << roomName;
+            ss << roomName;
             auto roomCreateInst = ServerAction(classes::general::ServerActionType::CreateChatroom,
                                                {},
                                                ss.str());
@@ -246,10 +247,7 @@ namespace terminal {
             Accounts[0].ChatRooms.emplace(roomName, roomID);
             for (auto curAdd: ids) {
                 ss = {};
-                ss << Accounts[0].ID << " "
-                   << Accounts[0].ConnectionKey << " "
-                   << roomID << " "
-                   << curAdd;
+                ss << roomID << " " << curAdd;
                 auto joinInst = ServerAction(classes::general::ServerActionType::AddChatRoomMember,
                                              {},
                                              ss.str());
@@ -282,12 +280,17 @@ namespace terminal {
             if (curRoomID == -1)
                 return;
             stringstream ss;
-            ss << Accounts[0].ID << " " << Accounts[0].ConnectionKey
-               << " " << curRoomID << " " << any_cast<string>(toHandle.Params[0].Value);
+            ss << curRoomID << " " << any_cast<string>(toHandle.Params[0].Value);
             auto resp = ServerConn->Request(ServerAction(classes::general::ServerActionType::SendMessage,
                                                          {},
                                                          ss.str()), classes::client_side::ExpectStatus::RegularInform);
             cout << resp.Data << endl;
+        } else if (curName == "tp") {
+            if (curRoomID == -1)
+                return;
+            stringstream ss;
+            ss << curRoomID << " " << (any_cast<unsigned long long>(toHandle.Params[0].Value) ? 1 : 0);
+            ServerConn->Send(ServerAction(classes::general::ServerActionType::SetTyping, {}, ss.str()));
         } else if (curName == "sl") {
             if (!ServerBuilt)
                 return;
@@ -298,6 +301,71 @@ namespace terminal {
                 cout << "Printing server log:" << endl;
             for (auto &cur: CurrentServer->ServerLog)
                 cout << "\tServer Log[" << i++ << "]= " << cur << endl;
+        } else if (curName == "an") {
+            if (!ServerBuilt)
+                return;
+            auto report = CurrentServer->Announce(any_cast<string>(toHandle.Params[0].Value));
+            cout << "Announcement delivered to " << report.Delivered << " connected client(s)"
+                 << ", dropped for " << report.Dropped
+                 << ", queued for " << report.Queued << " offline client(s)"
+                 << " in " << report.Elapsed.count() << "us" << endl;
+        } else if (curName == "dur") {
+            if (!ServerBuilt)
+                return;
+            auto mode = any_cast<unsigned long long>(toHandle.Params[0].Value);
+            if (mode > static_cast<unsigned long long>(classes::server_side::Durability::PerMessage)) {
+                cerr << "Durability mode must be 0 (none), 1 (batched) or 2 (per-message)" << endl;
+                return;
+            }
+            CurrentServer->SetDurability(static_cast<classes::server_side::Durability>(mode));
+        } else if (curName == "snap") {
+            if (!ServerBuilt)
+                return;
+            auto report = CurrentServer->TakeSnapshot();
+            if (report.Bytes == 0) {
+                cerr << "Writing the snapshot failed" << endl;
+                return;
+            }
+            cout << "Snapshot of " << report.Clients << " client(s) and " << report.Rooms << " room(s)"
+                 << " up to lsn " << report.Lsn
+                 << ", " << report.Bytes << " bytes in " << report.Elapsed.count() << "ms" << endl;
+        } else if (curName == "sst") {
+            if (!ServerBuilt)
+                return;
+            cout << "Ingress lanes:" << endl;
+            for (size_t lane = 0; lane < ActionLaneCount; lane++) {
+                auto metrics = CurrentServer->GetLaneMetrics((ActionLane) lane);
+                cout << "\t" << ActionLanes::LaneName((ActionLane) lane)
+                     << ": depth=" << metrics.Depth
+                     << " peak=" << metrics.PeakDepth
+                     << " enqueued=" << metrics.Enqueued
+                     << " dequeued=" << metrics.Dequeued << endl;
+            }
+            cout << "Admission:" << endl
+                 << "\tqueue latency=" << CurrentServer->GetQueueLatencyMicros() << "us"
+                 << " rate-limited=" << CurrentServer->GetRejectedCount()
+                 << " shed=" << CurrentServer->GetShedCount() << endl;
+            cout << "Fan-out:" << endl
+                 << "\tbacklog=" << CurrentServer->GetFanoutBacklog()
+                 << " dropped=" << classes::server_side::OutboundQueue::TotalDropped()
+                 << " skipped=" << classes::server_side::OutboundQueue::TotalSkipped() << endl;
+            cout << "Presence:" << endl
+                 << "\tpending=" << CurrentServer->GetPresencePending()
+                 << " coalesced=" << CurrentServer->GetPresenceCoalesced() << endl;
+            auto wal = CurrentServer->GetWalStats();
+            cout << "Write-ahead log:" << endl
+                 << "\tmode=" << static_cast<int>(wal.Mode)
+                 << " last lsn=" << wal.LastLsn
+                 << " durable lsn=" << wal.DurableLsn
+                 << " syncs=" << wal.Syncs << endl
+                 << "\tsnapshot lsn=" << CurrentServer->GetSnapshotLsn() << endl;
+            cout << "Object pools:" << endl;
+            for (auto &pool: classes::server_side::util::PoolRegistry::Snapshot())
+                cout << "\tblock=" << pool.BlockSize << "B"
+                     << ": slabs=" << pool.Slabs
+                     << " capacity=" << pool.Capacity
+                     << " in-use=" << pool.InUse << endl;
+            cout << "Interned names: " << classes::server_side::util::StringTable::Global().Size() << endl;
         }
     }
 
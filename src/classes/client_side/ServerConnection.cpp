@@ -2,9 +2,10 @@
 #include <cstring>
 #include <iostream>
 #include <sstream>
+#include <charconv>
 
 #include "ServerConnection.h"
-#include "../../terminal/Terminal.h"
+#include "../../Terminal/Terminal.h"
 
 using namespace terminal;
 
@@ -141,19 +142,10 @@ namespace classes::client_side {
                 }
                 string s_resp(buffer);
 
-                auto response = ClientAction::Deserialize(s_resp);
-                if(response.ActionType != general::ClientActionType::MessageReceived)
-                    PushResp(std::move(response));
-                else
-                    PushMess(std::move(response));
-
-                if (!r_next.empty()) {
-                    response = ClientAction::Deserialize(r_next);
-                    if(response.ActionType != general::ClientActionType::MessageReceived)
-                        PushResp(std::move(response));
-                    else
-                        PushMess(std::move(response));
-                }
+                Route(ClientAction::Deserialize(s_resp));
+
+                if (!r_next.empty())
+                    Route(ClientAction::Deserialize(r_next));
             }
         });
 
@@ -165,9 +157,9 @@ namespace classes::client_side {
                     auto mess = PopMess();
                     if (!PoppedEmpty->load()) {
                         stringstream ss(mess.Data);
-                        unsigned long long Sender, Room;
+                        unsigned long long Sender, Room, Seq;
                         string msgContent;
-                        ss >> Sender >> Room;
+                        ss >> Sender >> Room >> Seq;
                         getline(ss, msgContent);
 
                         string RoomName;
@@ -185,7 +177,8 @@ namespace classes::client_side {
                     case ExpectStatus::None: {
                         auto resp = PopResp();
                         if (resp.ActionType == general::ClientActionType::InformActionSuccess ||
-                            resp.ActionType == general::ClientActionType::InformActionFailure) {
+                            resp.ActionType == general::ClientActionType::InformActionFailure ||
+                            resp.ActionType == general::ClientActionType::InformServerBusy) {
                             PushResp(move(resp));
                             continue;
                         }
@@ -244,6 +237,11 @@ namespace classes::client_side {
         return response;
     }
 
+    void ServerConnection::Send(ServerAction action) {
+        auto snd = action.Serialize();
+        send(ServerFD, snd.c_str(), snd.size(), 0);
+    }
+
     void ServerConnection::PushReq(const ServerAction& req) {
         {
             lock_guard<mutex> guard(m_OutgoingRequests);
@@ -284,6 +282,80 @@ namespace classes::client_side {
         }
     }
 
+    void ServerConnection::Route(ClientAction response) {
+        if (response.ActionType == general::ClientActionType::MessageBatch) {
+            // "<count> " followed by "<length>:<frame>" for every packed message
+            const string &data = response.Data;
+            size_t pos = data.find(' ');
+            if (pos == string::npos)
+                return;
+            pos++;
+            while (pos < data.size()) {
+                size_t colon = data.find(':', pos);
+                size_t len = 0;
+                if (colon == string::npos ||
+                    from_chars(data.data() + pos, data.data() + colon, len).ec != errc() ||
+                    colon + 1 + len > data.size())
+                    return;
+                string frame = data.substr(colon + 1, len);
+                Route(ClientAction::Deserialize(frame));
+                pos = colon + 1 + len;
+            }
+            return;
+        }
+        if (response.ActionType == general::ClientActionType::MessageGap) {
+            // The server skipped messages while we were behind, fetch them back from the room's history
+            stringstream ss(response.Data);
+            unsigned long long Room, LastDelivered, Missed;
+            if (!(ss >> Room >> LastDelivered >> Missed))
+                return;
+            cout << "[INFO]: Missed " << Missed << " message(s) in chatroom #" << Room
+                 << ", fetching them from history." << endl;
+            stringstream req;
+            req << Room << " " << LastDelivered + 1 << " " << Missed;
+            Send(ServerAction(ServerActionType::FetchHistory, {}, req.str()));
+            return;
+        }
+        if (response.ActionType == general::ClientActionType::Announcement) {
+            cout << "[ANNOUNCEMENT]: " << response.Data << endl;
+            return;
+        }
+        if (response.ActionType == general::ClientActionType::PresenceUpdate) {
+            // "<count> " then "<clientID> <state> <roomID or *> " per entry
+            stringstream ss(response.Data);
+            size_t count = 0;
+            ss >> count;
+            for (size_t i = 0; i < count; i++) {
+                unsigned long long Subject;
+                int State;
+                string Room;
+                if (!(ss >> Subject >> State >> Room))
+                    return;
+                cout << "[PRESENCE]: Client '" << Subject << "' ";
+                switch ((PresenceState) State) {
+                    case PresenceState::Offline:
+                        cout << "went offline";
+                        break;
+                    case PresenceState::Online:
+                        cout << "is online";
+                        break;
+                    case PresenceState::Idle:
+                        cout << "stopped typing in chatroom #" << Room;
+                        break;
+                    case PresenceState::Typing:
+                        cout << "is typing in chatroom #" << Room;
+                        break;
+                }
+                cout << endl;
+            }
+            return;
+        }
+        if (response.ActionType != general::ClientActionType::MessageReceived)
+            PushResp(std::move(response));
+        else
+            PushMess(std::move(response));
+    }
+
     void ServerConnection::PushMess(ClientAction act) {
         {
             lock_guard<mutex> guard(m_IngoingMessages);
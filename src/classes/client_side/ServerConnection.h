@@ -50,6 +50,10 @@ namespace classes::client_side {
         bool Connect(bool Register, unsigned long long int id=-1, const string& key="", const string &DisplayName="");
 
         ClientAction Request(ServerAction action, ExpectStatus expect);
+        /**
+         * Sends a request the server does not answer, such as a typing indicator.
+         */
+        void Send(ServerAction action);
     private:
         void PushReq(const ServerAction& req);
         ClientAction PopResp();
@@ -64,6 +68,10 @@ namespace classes::client_side {
         ServerAction PopReq();
         void PushResp(ClientAction resp);
         void PushMess(ClientAction ms);
+        /**
+         * Files a frame from the server under responses or messages, unpacking MessageBatch frames.
+         */
+        void Route(ClientAction response);
         ClientAction PopMess();
     };
 
@@ -7,7 +7,12 @@ namespace classes::general{
         InformActionFailure,
         MessageReceived,
         JoinedChatroom,
-        LeftChatroom
+        LeftChatroom,
+        InformServerBusy,
+        MessageBatch,
+        MessageGap,
+        PresenceUpdate,
+        Announcement
     };
     enum class ServerActionType{
         SendMessage,
@@ -17,7 +22,15 @@ namespace classes::general{
         CreateChatroom,
         RemoveChatroom,
         AddChatRoomMember,
-        RemoveChatroomMember
+        RemoveChatroomMember,
+        FetchHistory,
+        SetTyping
+    };
+    enum class PresenceState{
+        Offline,
+        Online,
+        Idle,
+        Typing
     };
 }
 
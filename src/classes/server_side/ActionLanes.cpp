@@ -0,0 +1,101 @@
+#include "ActionLanes.h"
+
+namespace classes::server_side {
+    ActionLanes::ActionLanes() : ActionLanes({8, 4, 1}) {}
+
+    ActionLanes::ActionLanes(array<unsigned int, ActionLaneCount> weights) :
+            Weights(weights), Credits(), Stats() {
+        for (auto &w: Weights)
+            if (w == 0)
+                w = 1;
+        Credits = Weights;
+    }
+
+    ActionLane ActionLanes::Classify(ServerActionType type) {
+        switch (type) {
+            case ServerActionType::RegisterClient:
+            case ServerActionType::LoginClient:
+            case ServerActionType::LogoutClient:
+                return ActionLane::Control;
+            case ServerActionType::CreateChatroom:
+            case ServerActionType::RemoveChatroom:
+            case ServerActionType::AddChatRoomMember:
+            case ServerActionType::RemoveChatroomMember:
+                return ActionLane::Membership;
+            case ServerActionType::SendMessage:
+            case ServerActionType::FetchHistory:
+            case ServerActionType::SetTyping:
+            default:
+                return ActionLane::Messages;
+        }
+    }
+
+    const char *ActionLanes::LaneName(ActionLane lane) {
+        switch (lane) {
+            case ActionLane::Control:
+                return "Control";
+            case ActionLane::Membership:
+                return "Membership";
+            case ActionLane::Messages:
+                return "Messages";
+        }
+        return "Unknown";
+    }
+
+    void ActionLanes::Push(Entry entry) {
+        auto &act = get<1>(entry);
+        auto lane = (size_t) Classify(act ? act->ActionType : ServerActionType::SendMessage);
+        Lanes[lane].emplace(move(entry), chrono::steady_clock::now());
+        auto &stats = Stats[lane];
+        stats.Enqueued++;
+        stats.Depth = Lanes[lane].size();
+        if (stats.Depth > stats.PeakDepth)
+            stats.PeakDepth = stats.Depth;
+    }
+
+    bool ActionLanes::Pop(Entry &out, chrono::microseconds &waited) {
+        if (Empty())
+            return false;
+
+        // Highest priority lane that still has credit in this round wins. Once every non-empty lane has spent
+        // its credit, a new round starts.
+        for (int round = 0; round < 2; round++) {
+            for (size_t lane = 0; lane < ActionLaneCount; lane++) {
+                if (Lanes[lane].empty() || Credits[lane] == 0)
+                    continue;
+                Credits[lane]--;
+                auto &slot = Lanes[lane].front();
+                out = move(get<0>(slot));
+                waited = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - get<1>(slot));
+                Lanes[lane].pop();
+                Stats[lane].Dequeued++;
+                Stats[lane].Depth = Lanes[lane].size();
+                return true;
+            }
+            Refill();
+        }
+        return false;
+    }
+
+    bool ActionLanes::Empty() const {
+        for (auto &lane: Lanes)
+            if (!lane.empty())
+                return false;
+        return true;
+    }
+
+    size_t ActionLanes::Size() const {
+        size_t res = 0;
+        for (auto &lane: Lanes)
+            res += lane.size();
+        return res;
+    }
+
+    LaneMetrics ActionLanes::Metrics(ActionLane lane) const {
+        return Stats[(size_t) lane];
+    }
+
+    void ActionLanes::Refill() {
+        Credits = Weights;
+    }
+} // namespace classes::server_side
@@ -0,0 +1,63 @@
+#ifndef CHAT2_ACTIONLANES_H
+#define CHAT2_ACTIONLANES_H
+
+#include <memory>
+#include <tuple>
+#include <queue>
+#include <array>
+#include <chrono>
+
+#include "../general/ServerAction.h"
+#include "RegisteredClient.h"
+
+using namespace std;
+using namespace classes::general;
+
+namespace classes::server_side {
+    enum class ActionLane {
+        Control = 0,
+        Membership = 1,
+        Messages = 2
+    };
+
+    constexpr size_t ActionLaneCount = 3;
+
+    struct LaneMetrics {
+        unsigned long long Depth;
+        unsigned long long PeakDepth;
+        unsigned long long Enqueued;
+        unsigned long long Dequeued;
+    };
+
+    /**
+     * Ingress queue split into one FIFO lane per ActionLane. Pop() serves the lanes by weighted round robin,
+     * so a flood on a lower lane can slow, but never starve, a higher one. Not thread safe, the owner locks.
+     */
+    class ActionLanes {
+    public:
+        typedef tuple<shared_ptr<RegisteredClient>, shared_ptr<ServerAction>> Entry;
+
+        ActionLanes();
+        explicit ActionLanes(array<unsigned int, ActionLaneCount> weights);
+
+        static ActionLane Classify(ServerActionType type);
+        static const char *LaneName(ActionLane lane);
+
+        void Push(Entry entry);
+        bool Pop(Entry &out, chrono::microseconds &waited);
+        bool Empty() const;
+        size_t Size() const;
+        LaneMetrics Metrics(ActionLane lane) const;
+    private:
+        typedef tuple<Entry, chrono::steady_clock::time_point> Slot;
+
+        array<queue<Slot>, ActionLaneCount> Lanes;
+        array<unsigned int, ActionLaneCount> Weights;
+        array<unsigned int, ActionLaneCount> Credits;
+        array<LaneMetrics, ActionLaneCount> Stats;
+
+        void Refill();
+    };
+} // namespace classes::server_side
+
+#endif //CHAT2_ACTIONLANES_H
@@ -0,0 +1,19 @@
+#include "BatchController.h"
+
+#include <algorithm>
+
+namespace classes::server_side {
+    BatchController::BatchController(size_t minBatch, size_t maxBatch) :
+            MinBatch(std::max<size_t>(minBatch, 1)), MaxBatch(std::max(maxBatch, minBatch)), Size(MinBatch) {}
+
+    size_t BatchController::Current() const {
+        return Size;
+    }
+
+    void BatchController::Update(size_t drained) {
+        if (drained >= Size)
+            Size = std::min(MaxBatch, Size * 2);
+        else if (drained <= Size / 4)
+            Size = std::max(MinBatch, Size / 2);
+    }
+} // namespace classes::server_side
@@ -0,0 +1,25 @@
+#ifndef CHAT2_BATCHCONTROLLER_H
+#define CHAT2_BATCHCONTROLLER_H
+
+#include <cstddef>
+
+namespace classes::server_side {
+    /**
+     * Chooses how many actions the dispatcher drains per lock acquisition. The batch doubles while every drain
+     * comes back full and halves when drains come back mostly empty, so an idle server handles one action at a
+     * time and a loaded one amortizes locking and room lookups over many.
+     */
+    class BatchController {
+    public:
+        explicit BatchController(size_t minBatch = 1, size_t maxBatch = 256);
+
+        size_t Current() const;
+        void Update(size_t drained);
+    private:
+        size_t MinBatch;
+        size_t MaxBatch;
+        size_t Size;
+    };
+} // namespace classes::server_side
+
+#endif //CHAT2_BATCHCONTROLLER_H
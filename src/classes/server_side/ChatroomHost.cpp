@@ -4,18 +4,57 @@
 
 #include "ChatroomHost.h"
 
+#include <algorithm>
+
 namespace classes::server_side {
     unsigned long long ChatroomHost::count = 0;
-    ChatroomHost::ChatroomHost() {
-        this->RoomID=count++;
+    ChatroomHost::ChatroomHost() : RoomID(count++), History(RoomID) {
     }
     ChatroomHost::ChatroomHost(string name, RegisteredClient *Admin) :
-    DisplayName(move(name)){
-        Members.push_back(Admin);
+    RoomID(count++), DisplayName(util::Symbol::Intern(name)), History(RoomID){
+        Members.Insert(Admin->ClientID, Admin->Slot);
+        this->Admin=Admin;
+    }
+    ChatroomHost::ChatroomHost(unsigned long long rID, string name, RegisteredClient *Admin) :
+    RoomID(rID), DisplayName(util::Symbol::Intern(name)), History(rID){
+        Members.Insert(Admin->ClientID, Admin->Slot);
         this->Admin=Admin;
+        ResumeIDs(rID + 1);
+    }
+
+    unsigned long long ChatroomHost::NextID() {
+        return count;
+    }
+
+    void ChatroomHost::ResumeIDs(unsigned long long next) {
+        count = max(count, next);
+    }
+
+    unsigned long long ChatroomHost::PushMessage(unsigned long long int senderID, string_view content) {
+        auto seq = Messages.Append(senderID, content);
+        History.Append(seq, senderID, content);
+        return seq;
+    }
+
+    unsigned long long ChatroomHost::FirstSeq() const {
+        return History.SegmentCount() ? min(Messages.FirstSeq(), History.FirstSeq()) : Messages.FirstSeq();
     }
 
-    void ChatroomHost::PushMessage(unsigned long long int senderID, const string& content) {
-        Messages.emplace(this->Messages.size(),tuple<unsigned long long,string>(senderID,content));
+    size_t ChatroomHost::ReadMessages(unsigned long long fromSeq, size_t count, vector<LoggedMessage> &out) const {
+        size_t added = 0;
+        auto seq = max(fromSeq, FirstSeq());
+        // Older than what memory retains: one lookup in the store, then sequential reads from its mappings
+        if (seq < Messages.FirstSeq()) {
+            auto wanted = min<unsigned long long>(count, Messages.FirstSeq() - seq);
+            added = History.ReadAfter(seq - 1, wanted, out);
+            // Past a gap in the store the read can run into what memory still has
+            for (; added > 0 && out.back().Seq >= Messages.FirstSeq(); added--)
+                out.pop_back();
+            seq = Messages.FirstSeq();
+        }
+        LoggedMessage msg{};
+        for (; added < count && Messages.Read(seq, msg); seq++, added++)
+            out.push_back(msg);
+        return added;
     }
 }
\ No newline at end of file
@@ -3,25 +3,54 @@
 
 #include <vector>
 #include <tuple>
-#include <map>
 #include <string>
 
 #include "RegisteredClient.h"
+#include "MessageLog.h"
+#include "HistoryStore.h"
+#include "util/StringTable.h"
+#include "util/MemberSet.h"
 
 using namespace std;
 
 namespace classes::server_side {
+    struct FanoutTargets;
+
     class ChatroomHost {
     public:
         unsigned long long RoomID;
-        string DisplayName;
+        util::Symbol DisplayName;
         RegisteredClient *Admin;
-        vector<RegisteredClient*> Members;
-        map<int,tuple<unsigned long long, string>> Messages;
+        util::MemberSet<uint32_t> Members;
+        MessageLog Messages;
+        // Everything Messages no longer retains
+        HistoryStore History;
+        /**
+         * Fan-out snapshot of Members, rebuilt on the next broadcast after it is reset by a membership change.
+         */
+        shared_ptr<const FanoutTargets> Audience;
 
         ChatroomHost();
         explicit ChatroomHost(string name, RegisteredClient *Admin);
-        void PushMessage(unsigned long long senderID, const string& content);
+        /**
+         * Recreates a room from a snapshot or the WAL under its earlier ID.
+         */
+        ChatroomHost(unsigned long long rID, string name, RegisteredClient *Admin);
+        /**
+         * Appends to the room's history and returns the message's sequence number.
+         */
+        unsigned long long PushMessage(unsigned long long senderID, string_view content);
+        /**
+         * Oldest message still readable, from memory or from the history store.
+         */
+        unsigned long long FirstSeq() const;
+        /**
+         * Up to count messages starting at fromSeq, oldest first. Contents stay valid until the next PushMessage().
+         */
+        size_t ReadMessages(unsigned long long fromSeq, size_t count, vector<LoggedMessage> &out) const;
+
+        static unsigned long long NextID();
+        static void ResumeIDs(unsigned long long next);
     private:
         static unsigned long long count;
     };
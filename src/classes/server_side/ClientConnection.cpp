@@ -1,5 +1,6 @@
 #include "ClientConnection.h"
 #include "RegisteredClient.h"
+#include "util/SlabPool.h"
 #include <memory>
 #include <mutex>
 
@@ -8,17 +9,20 @@ using namespace std;
 namespace classes::server_side {
 
     ClientConnection::ClientConnection()
-            : ManagerThread(nullptr), FileDescriptor(-1), ThreadInitialized(false),
-              StopFlag(make_shared<atomic<bool>>(false)), ListenerFunction(nullptr), m_Host(make_shared<mutex>()) {}
+            : ManagerThread(nullptr), FileDescriptor(-1), SessionToken(0), ThreadInitialized(false),
+              StopFlag(util::MakePooled<atomic<bool>>(false)), ListenerFunction(nullptr), m_Host(util::MakePooled<mutex>()),
+              Paused(false) {}
 
     ClientConnection::ClientConnection(AddressInfo addr)
-            : Address(addr), ManagerThread(nullptr), FileDescriptor(-1), ThreadInitialized(false),
-              StopFlag(make_shared<atomic<bool>>(false)), ListenerFunction(nullptr), m_Host(make_shared<mutex>()) {}
+            : Address(addr), ManagerThread(nullptr), FileDescriptor(-1), SessionToken(0), ThreadInitialized(false),
+              StopFlag(util::MakePooled<atomic<bool>>(false)), ListenerFunction(nullptr), m_Host(util::MakePooled<mutex>()),
+              Paused(false) {}
 
     ClientConnection::ClientConnection(ClientConnection &&other) noexcept
-            : Address(other.Address), ManagerThread(other.ManagerThread), FileDescriptor(other.FileDescriptor),
+            : Address(other.Address), PeerAddress(move(other.PeerAddress)), ManagerThread(other.ManagerThread), FileDescriptor(other.FileDescriptor),
+              SessionToken(other.SessionToken),
               ThreadInitialized(other.ThreadInitialized), StopFlag(move(other.StopFlag)),
-              ListenerFunction(other.ListenerFunction), m_Host(move(other.m_Host)) {
+              ListenerFunction(other.ListenerFunction), m_Host(move(other.m_Host)), Paused(false) {
         other.ManagerThread = nullptr;
         other.ThreadInitialized = false;
     }
@@ -31,7 +35,9 @@ namespace classes::server_side {
         Stop();  // Ensure the current instance stops its thread if running.
 
         Address = other.Address;
+        PeerAddress = move(other.PeerAddress);
         FileDescriptor = other.FileDescriptor;
+        SessionToken = other.SessionToken;
         ThreadInitialized = other.ThreadInitialized;
         StopFlag = move(other.StopFlag);
         ListenerFunction = other.ListenerFunction;
@@ -44,6 +50,20 @@ namespace classes::server_side {
         return *this;
     }
 
+    void *ClientConnection::operator new(size_t size) {
+        if (size != sizeof(ClientConnection))
+            return ::operator new(size);
+        return util::SlabPool<sizeof(ClientConnection), alignof(ClientConnection)>::Instance().Allocate();
+    }
+
+    void ClientConnection::operator delete(void *ptr, size_t size) {
+        if (size != sizeof(ClientConnection)) {
+            ::operator delete(ptr);
+            return;
+        }
+        util::SlabPool<sizeof(ClientConnection), alignof(ClientConnection)>::Instance().Deallocate(ptr);
+    }
+
     ClientConnection::~ClientConnection() {
         Stop();
         if (ManagerThread && ManagerThread->joinable()) {
@@ -57,9 +77,11 @@ namespace classes::server_side {
             return;
         }
         ListenerFunction = listener;
-        StopFlag = make_unique<atomic<bool>>(false);
+        StopFlag = util::MakePooled<atomic<bool>>(false);
         ManagerThread = new thread([this] {
             while (!StopFlag->load()) {
+                // Set while LinkClientConnection() hands the connection to another client
+                Paused.wait(true);
                 {
                     lock_guard<mutex> guard(*m_Host);
                     ListenerFunction(Host, FileDescriptor, StopFlag);
@@ -70,6 +92,15 @@ namespace classes::server_side {
         ThreadInitialized = true;
     }
 
+    void ClientConnection::Pause() {
+        Paused.store(true);
+    }
+
+    void ClientConnection::Resume() {
+        Paused.store(false);
+        Paused.notify_all();
+    }
+
     void ClientConnection::Stop() {
         if (ThreadInitialized) {
             StopFlag->store(true);
@@ -8,6 +8,7 @@
 #include <memory>
 #include <mutex>
 #include <functional>
+#include <string>
 
 typedef addrinfo AddressInfo;
 
@@ -19,8 +20,10 @@ namespace classes::server_side {
     struct ClientConnection {
     public:
         AddressInfo Address;
+        string PeerAddress;
         thread *ManagerThread;
         int FileDescriptor;
+        unsigned long long SessionToken;
         bool ThreadInitialized;
         shared_ptr<RegisteredClient> Host;
 
@@ -32,13 +35,23 @@ namespace classes::server_side {
         ClientConnection &operator=(ClientConnection &&other) noexcept;
         ~ClientConnection();
 
+        // Connections churn with every accept, so they come from a slab pool instead of the general heap
+        static void *operator new(size_t size);
+        static void operator delete(void *ptr, size_t size);
+
         void Start(const function<void(shared_ptr<RegisteredClient> Host, int FD, shared_ptr<atomic<bool>> stop)>& listener);
         void Stop();
+        /**
+         * Holds the thread before its next listener call, Resume() lets it go on with whatever Host is then.
+         */
+        void Pause();
+        void Resume();
         shared_ptr<mutex> m_Host;  // Changed to shared_ptr
     private:
         shared_ptr<atomic<bool>> StopFlag;
 
         function<void(shared_ptr<RegisteredClient> Host, int FD, shared_ptr<atomic<bool>> stop)> ListenerFunction;
+        atomic<bool> Paused;
     };
 } // server_side
 
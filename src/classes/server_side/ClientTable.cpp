@@ -0,0 +1,61 @@
+#include "ClientTable.h"
+#include "RegisteredClient.h"
+#include "OutboundQueue.h"
+
+namespace classes::server_side {
+    uint32_t ClientTable::Add(RegisteredClient *client, bool guest) {
+        uint32_t slot;
+        if (!FreeSlots.empty()) {
+            slot = FreeSlots.back();
+            FreeSlots.pop_back();
+        } else {
+            slot = (uint32_t) Ids.size();
+            Ids.emplace_back();
+            Flags.emplace_back();
+            Queues.emplace_back();
+            Records.emplace_back();
+        }
+        Ids[slot] = client->ClientID;
+        Flags[slot] = guest ? GuestFlag : 0;
+        Queues[slot] = client->Outbound.get();
+        Records[slot] = client;
+        client->Slot = slot;
+        return slot;
+    }
+
+    void ClientTable::Remove(uint32_t slot) {
+        if (slot >= Ids.size() || !Records[slot])
+            return;
+        Records[slot]->Slot = NoSlot;
+        Flags[slot] = FreeFlag;
+        Queues[slot] = nullptr;
+        Records[slot] = nullptr;
+        FreeSlots.push_back(slot);
+    }
+
+    void ClientTable::Push(uint32_t slot, const util::FrameRef &frame) {
+        Queues[slot]->Push(frame);
+    }
+
+    void ClientTable::Reserve(size_t count) {
+        Ids.reserve(count);
+        Flags.reserve(count);
+        Queues.reserve(count);
+        Records.reserve(count);
+    }
+
+    size_t ClientTable::Size() const {
+        return Ids.size() - FreeSlots.size();
+    }
+
+    size_t ClientTable::CollectConnected(vector<OutboundQueue *> &out) const {
+        size_t offline = 0;
+        for (size_t slot = 0; slot < Flags.size(); slot++) {
+            if (Flags[slot] & ConnectedFlag)
+                out.push_back(Queues[slot]);
+            else if (!(Flags[slot] & (GuestFlag | FreeFlag)))
+                offline++;
+        }
+        return offline;
+    }
+} // namespace classes::server_side
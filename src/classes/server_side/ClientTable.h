@@ -0,0 +1,62 @@
+#ifndef CHAT2_CLIENTTABLE_H
+#define CHAT2_CLIENTTABLE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "util/FramePool.h"
+
+using namespace std;
+
+namespace classes::server_side {
+    class RegisteredClient;
+    class OutboundQueue;
+
+    const uint32_t NoSlot = UINT32_MAX;
+
+    /**
+     * Hot client state as a structure of arrays indexed by a dense slot number. Fan-out walks member slots and
+     * only touches the Ids, Connected and Queues arrays; everything else about a client stays in its
+     * RegisteredClient record, reached through Records. Freed slots are reused. Guarded by Server::m_Clients.
+     */
+    class ClientTable {
+    public:
+        /**
+         * Guests hold a slot until they log in as a registered client.
+         */
+        uint32_t Add(RegisteredClient *client, bool guest = false);
+        void Remove(uint32_t slot);
+
+        unsigned long long Id(uint32_t slot) const { return Ids[slot]; }
+        bool Connected(uint32_t slot) const { return Flags[slot] & ConnectedFlag; }
+        bool Guest(uint32_t slot) const { return Flags[slot] & GuestFlag; }
+        void SetConnected(uint32_t slot, bool connected) {
+            Flags[slot] = connected ? (Flags[slot] | ConnectedFlag) : (Flags[slot] & ~ConnectedFlag);
+        }
+        OutboundQueue *Queue(uint32_t slot) const { return Queues[slot]; }
+        RegisteredClient *Record(uint32_t slot) const { return Records[slot]; }
+
+        void Push(uint32_t slot, const util::FrameRef &frame);
+        size_t Size() const;
+        void Reserve(size_t count);
+        /**
+         * Appends the queues of all connected clients and returns how many registered clients are offline.
+         * One pass over the Flags and Queues arrays.
+         */
+        size_t CollectConnected(vector<OutboundQueue *> &out) const;
+    private:
+        static constexpr uint8_t ConnectedFlag = 1;
+        static constexpr uint8_t GuestFlag = 2;
+        // Set on freed slots, so they count as neither online nor offline
+        static constexpr uint8_t FreeFlag = 4;
+
+        vector<unsigned long long> Ids;
+        vector<uint8_t> Flags;
+        vector<OutboundQueue *> Queues;
+        vector<RegisteredClient *> Records;
+        vector<uint32_t> FreeSlots;
+    };
+} // namespace classes::server_side
+
+#endif //CHAT2_CLIENTTABLE_H
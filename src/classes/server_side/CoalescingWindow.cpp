@@ -0,0 +1,21 @@
+#include "CoalescingWindow.h"
+
+namespace classes::server_side {
+    chrono::microseconds CoalescingWindow::Current() const {
+        return Window;
+    }
+
+    void CoalescingWindow::Update(size_t coalesced, bool backlog) {
+        if (backlog || coalesced > 1) {
+            Window = Window.count() == 0 ? MinWindow : min(Window * 2, MaxWindow);
+            return;
+        }
+        Window /= 2;
+        if (Window < MinWindow)
+            Window = chrono::microseconds(0);
+    }
+
+    void CoalescingWindow::Idle() {
+        Window = chrono::microseconds(0);
+    }
+} // namespace classes::server_side
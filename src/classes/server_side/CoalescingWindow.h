@@ -0,0 +1,32 @@
+#ifndef CHAT2_COALESCINGWINDOW_H
+#define CHAT2_COALESCINGWINDOW_H
+
+#include <chrono>
+#include <cstddef>
+
+using namespace std;
+
+namespace classes::server_side {
+    /**
+     * Adaptive per-client window for packing MessageReceived frames into one write. The window opens at
+     * MinWindow once a write leaves frames behind, doubles while bursts continue up to MaxWindow, halves after
+     * writes that found nothing to pack, and drops to zero whenever the connection goes idle, so a lone message
+     * is never held back.
+     */
+    class CoalescingWindow {
+    public:
+        static constexpr chrono::microseconds MinWindow{50};
+        static constexpr chrono::microseconds MaxWindow{400};
+
+        chrono::microseconds Current() const;
+        /**
+         * Called after a write of `coalesced` frames, `backlog` tells whether more frames were already waiting.
+         */
+        void Update(size_t coalesced, bool backlog);
+        void Idle();
+    private:
+        chrono::microseconds Window{0};
+    };
+} // namespace classes::server_side
+
+#endif //CHAT2_COALESCINGWINDOW_H
@@ -0,0 +1,79 @@
+#include "FanoutStage.h"
+#include "OutboundQueue.h"
+
+namespace classes::server_side {
+    FanoutStage::FanoutStage(unsigned int workerCount) : Pending(0), Stopping(false) {
+        if (workerCount == 0)
+            workerCount = 1;
+        for (unsigned int i = 0; i < workerCount; i++)
+            Workers.push_back(make_unique<Worker>());
+        for (size_t i = 0; i < Workers.size(); i++)
+            Workers[i]->Thread = thread([this, i]() { Run(i); });
+    }
+
+    FanoutStage::~FanoutStage() {
+        Stopping.store(true);
+        for (auto &worker: Workers) {
+            {
+                // Taking the lock orders the flag with a worker that is about to wait
+                lock_guard<mutex> guard(worker->m_Jobs);
+            }
+            worker->JobsCV.notify_all();
+        }
+        for (auto &worker: Workers)
+            if (worker->Thread.joinable())
+                worker->Thread.join();
+    }
+
+    shared_ptr<const FanoutTargets> FanoutStage::Snapshot(const util::MemberSet<uint32_t> &members,
+                                                          const ClientTable &table) const {
+        auto targets = make_shared<FanoutTargets>();
+        targets->Parts.resize(Workers.size());
+        for (auto &part: targets->Parts)
+            part.reserve(members.Size() / Workers.size() + 1);
+        targets->Count = 0;
+        for (auto slot: members) {
+            // Offline members catch up from the room's log when they log in
+            if (!table.Connected(slot))
+                continue;
+            targets->Parts[slot % Workers.size()].push_back(table.Queue(slot));
+            targets->Count++;
+        }
+        return targets;
+    }
+
+    void FanoutStage::Submit(shared_ptr<const FanoutTargets> targets, util::FrameRef frame) {
+        Pending.fetch_add(Workers.size(), memory_order_relaxed);
+        for (auto &worker: Workers) {
+            {
+                lock_guard<mutex> guard(worker->m_Jobs);
+                worker->Jobs.push_back(Job{targets, frame});
+            }
+            worker->JobsCV.notify_one();
+        }
+    }
+
+    size_t FanoutStage::Backlog() const {
+        return Pending.load(memory_order_relaxed) / Workers.size();
+    }
+
+    void FanoutStage::Run(size_t index) {
+        auto &worker = *Workers[index];
+        deque<Job> batch;
+        while (true) {
+            {
+                unique_lock<mutex> lock(worker.m_Jobs);
+                worker.JobsCV.wait(lock, [this, &worker]() { return Stopping || !worker.Jobs.empty(); });
+                if (worker.Jobs.empty())
+                    return;
+                batch.swap(worker.Jobs);
+            }
+            for (auto &job: batch) {
+                for (auto queue: job.Targets->Parts[index])
+                    queue->Push(job.Frame);
+                Pending.fetch_sub(1, memory_order_relaxed);
+            }
+            batch.clear();
+        }
+    }
+} // namespace classes::server_side
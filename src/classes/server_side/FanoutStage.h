@@ -0,0 +1,73 @@
+#ifndef CHAT2_FANOUTSTAGE_H
+#define CHAT2_FANOUTSTAGE_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+
+#include "util/FramePool.h"
+#include "util/MemberSet.h"
+#include "ClientTable.h"
+
+using namespace std;
+
+namespace classes::server_side {
+    class OutboundQueue;
+
+    /**
+     * Immutable snapshot of a room's connected member queues, split into one part per fan-out worker by slot. A queue always
+     * falls into the same part, so frames reach every member in the order they were submitted.
+     */
+    struct FanoutTargets {
+        vector<vector<OutboundQueue *>> Parts;
+        size_t Count;
+    };
+
+    /**
+     * Pipeline stage that delivers broadcast frames on its own threads. The dispatcher submits (snapshot, frame)
+     * jobs in O(workers) and moves on; each worker pushes the frame to its part of the snapshot.
+     */
+    class FanoutStage {
+    public:
+        explicit FanoutStage(unsigned int workerCount = 4);
+        ~FanoutStage();
+        FanoutStage(const FanoutStage &) = delete;
+        FanoutStage &operator=(const FanoutStage &) = delete;
+
+        /**
+         * Builds a snapshot of the connected members' queues, the caller must hold the lock guarding table.
+         */
+        shared_ptr<const FanoutTargets> Snapshot(const util::MemberSet<uint32_t> &members,
+                                                 const ClientTable &table) const;
+        void Submit(shared_ptr<const FanoutTargets> targets, util::FrameRef frame);
+        /**
+         * Jobs submitted but not yet delivered by every worker.
+         */
+        size_t Backlog() const;
+    private:
+        struct Job {
+            shared_ptr<const FanoutTargets> Targets;
+            util::FrameRef Frame;
+        };
+
+        struct Worker {
+            mutex m_Jobs;
+            condition_variable JobsCV;
+            deque<Job> Jobs;
+            thread Thread;
+        };
+
+        vector<unique_ptr<Worker>> Workers;
+        atomic<size_t> Pending;
+        atomic<bool> Stopping;
+
+        void Run(size_t index);
+    };
+} // namespace classes::server_side
+
+#endif //CHAT2_FANOUTSTAGE_H
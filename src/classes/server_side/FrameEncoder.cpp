@@ -0,0 +1,84 @@
+#include "FrameEncoder.h"
+
+#include <charconv>
+#include <cstring>
+
+namespace classes::server_side {
+    // An empty addrinfo serializes as socktype, family, addrlen, canonname, flags and protocol all zero or NULL
+    const string_view EmptyAddress = " 0 0 0 NULL 0 0 ";
+
+    static size_t WriteNumber(char *out, unsigned long long value) {
+        return to_chars(out, out + 20, value).ptr - out;
+    }
+
+    util::FrameRef FrameEncoder::Encode(ClientActionType type, string_view data) {
+        char typeBuf[20];
+        size_t typeLen = WriteNumber(typeBuf, static_cast<int>(type));
+        return util::FramePool::Build(typeLen + EmptyAddress.size() + data.size(), [&](char *out) {
+            memcpy(out, typeBuf, typeLen);
+            out += typeLen;
+            memcpy(out, EmptyAddress.data(), EmptyAddress.size());
+            out += EmptyAddress.size();
+            memcpy(out, data.data(), data.size());
+        }, static_cast<uint8_t>(type));
+    }
+
+    util::FrameRef FrameEncoder::MessageReceived(unsigned long long senderID, unsigned long long rID,
+                                                 unsigned long long seq, string_view content) {
+        // "<type> 0 0 0 NULL 0 0 <senderID> <rID> <seq> "
+        char header[100];
+        size_t len = WriteNumber(header, static_cast<int>(ClientActionType::MessageReceived));
+        memcpy(header + len, EmptyAddress.data(), EmptyAddress.size());
+        len += EmptyAddress.size();
+        len += WriteNumber(header + len, senderID);
+        header[len++] = ' ';
+        len += WriteNumber(header + len, rID);
+        header[len++] = ' ';
+        len += WriteNumber(header + len, seq);
+        header[len++] = ' ';
+        return util::FramePool::Build(len + content.size(), [&](char *out) {
+            memcpy(out, header, len);
+            memcpy(out + len, content.data(), content.size());
+        }, static_cast<uint8_t>(ClientActionType::MessageReceived), rID, seq);
+    }
+
+    util::FrameRef FrameEncoder::MessageGap(unsigned long long rID, unsigned long long lastDelivered,
+                                            unsigned long long missed) {
+        char data[64];
+        size_t len = WriteNumber(data, rID);
+        data[len++] = ' ';
+        len += WriteNumber(data + len, lastDelivered);
+        data[len++] = ' ';
+        len += WriteNumber(data + len, missed);
+        return Encode(ClientActionType::MessageGap, string_view(data, len));
+    }
+
+    size_t FrameEncoder::BatchRecordSize(const util::FrameRef &frame) {
+        char lenBuf[20];
+        return WriteNumber(lenBuf, frame.Size()) + 1 + frame.Size();
+    }
+
+    util::FrameRef FrameEncoder::MessageBatch(const vector<util::FrameRef> &frames) {
+        // "<type> 0 0 0 NULL 0 0 <count> " followed by "<len>:<frame>" per record
+        char header[80];
+        size_t len = WriteNumber(header, static_cast<int>(ClientActionType::MessageBatch));
+        memcpy(header + len, EmptyAddress.data(), EmptyAddress.size());
+        len += EmptyAddress.size();
+        len += WriteNumber(header + len, frames.size());
+        header[len++] = ' ';
+
+        size_t size = len;
+        for (auto &frame: frames)
+            size += BatchRecordSize(frame);
+        return util::FramePool::Build(size, [&](char *out) {
+            memcpy(out, header, len);
+            out += len;
+            for (auto &frame: frames) {
+                out += WriteNumber(out, frame.Size());
+                *out++ = ':';
+                memcpy(out, frame.Data(), frame.Size());
+                out += frame.Size();
+            }
+        }, static_cast<uint8_t>(ClientActionType::MessageBatch));
+    }
+} // namespace classes::server_side
@@ -0,0 +1,44 @@
+#ifndef CHAT2_FRAMEENCODER_H
+#define CHAT2_FRAMEENCODER_H
+
+#include <string_view>
+#include <vector>
+
+#include "../general/Enums.h"
+#include "util/FramePool.h"
+
+using namespace std;
+using namespace classes::general;
+
+namespace classes::server_side {
+    /**
+     * Writes server-to-client frames straight into pooled buffers, byte-for-byte what ClientAction::Serialize()
+     * produces for an action without an address, but with no stringstream or ClientAction in between. Meant for
+     * frames that are encoded once and pushed to many queues.
+     */
+    class FrameEncoder {
+    public:
+        static util::FrameRef Encode(ClientActionType type, string_view data);
+        /**
+         * MessageReceived frame, data is "<senderID> <roomID> <seq> <content>". The frame is tagged with the room
+         * and seq, so a lagging queue can tell which messages it skipped.
+         */
+        static util::FrameRef MessageReceived(unsigned long long senderID, unsigned long long rID,
+                                              unsigned long long seq, string_view content);
+        /**
+         * MessageGap frame, data is "<roomID> <lastDeliveredSeq> <missedCount>".
+         */
+        static util::FrameRef MessageGap(unsigned long long rID, unsigned long long lastDelivered,
+                                         unsigned long long missed);
+        /**
+         * Packs whole frames into one MessageBatch frame, data is "<count> " then "<length>:<frame>" per frame.
+         */
+        static util::FrameRef MessageBatch(const vector<util::FrameRef> &frames);
+        /**
+         * Bytes one frame adds to a MessageBatch.
+         */
+        static size_t BatchRecordSize(const util::FrameRef &frame);
+    };
+} // namespace classes::server_side
+
+#endif //CHAT2_FRAMEENCODER_H
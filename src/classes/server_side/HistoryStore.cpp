@@ -0,0 +1,252 @@
+#include "HistoryStore.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <utility>
+
+namespace classes::server_side {
+    HistoryStore::Mapping::Mapping(char *base, size_t length) : Base(base), Length(length) {}
+
+    HistoryStore::Mapping::~Mapping() {
+        munmap(Base, Length);
+    }
+
+    HistoryStore::HistoryStore(unsigned long long rID) : RoomID(rID), SyncedSegments(0), Failed(false) {}
+
+    HistoryStore::~HistoryStore() {
+        Release();
+    }
+
+    HistoryStore::HistoryStore(HistoryStore &&other) noexcept :
+            RoomID(other.RoomID), Segments(exchange(other.Segments, {})),
+            SyncedSegments(exchange(other.SyncedSegments, 0)), Failed(other.Failed) {}
+
+    HistoryStore &HistoryStore::operator=(HistoryStore &&other) noexcept {
+        if (this != &other) {
+            Release();
+            RoomID = other.RoomID;
+            Segments = exchange(other.Segments, {});
+            SyncedSegments = exchange(other.SyncedSegments, 0);
+            Failed = other.Failed;
+        }
+        return *this;
+    }
+
+    void HistoryStore::Append(unsigned long long seq, unsigned long long senderID, string_view content) {
+        if (Failed || (!Segments.empty() && seq < NextSeq()))
+            return;
+        auto size = RecordSize(content.size());
+        // Records of a segment have consecutive sequence numbers, which is what keeps the index sparse
+        if (Segments.empty() || !Segments.back().Active || seq != NextSeq() ||
+            Segments.back().Used + size > Segments.back().Capacity) {
+            if (!Segments.empty() && Segments.back().Active)
+                Seal(Segments.back());
+            if (!StartSegment(seq, size)) {
+                Failed = true;
+                return;
+            }
+        }
+
+        auto &segment = Segments.back();
+        if (segment.Count % IndexInterval == 0)
+            segment.Index.push_back(static_cast<uint32_t>(segment.Used));
+        RecordHeader header{seq, senderID, static_cast<uint32_t>(content.size()), 0};
+        memcpy(segment.Base + segment.Used, &header, sizeof(header));
+        memcpy(segment.Base + segment.Used + sizeof(header), content.data(), content.size());
+        segment.Used += size;
+        segment.Count++;
+    }
+
+    bool HistoryStore::Read(unsigned long long seq, LoggedMessage &out) const {
+        auto it = Locate(seq);
+        if (it == Segments.end() || seq < it->FirstSeq)
+            return false;
+        out = View(*it, OffsetOf(*it, seq - it->FirstSeq));
+        return true;
+    }
+
+    size_t HistoryStore::ReadAfter(unsigned long long afterSeq, size_t maxCount, vector<LoggedMessage> &out) const {
+        size_t added = 0;
+        auto seq = max(afterSeq + 1, FirstSeq());
+        auto it = Locate(seq);
+        if (it == Segments.end())
+            return 0;
+        size_t pos = seq > it->FirstSeq ? seq - it->FirstSeq : 0;
+        size_t offset = OffsetOf(*it, pos);
+        for (; it != Segments.end() && added < maxCount; ++it, pos = 0, offset = 0) {
+            for (; pos < it->Count && added < maxCount; pos++, added++) {
+                out.push_back(View(*it, offset));
+                offset += RecordSize(out.back().Content.size());
+            }
+        }
+        return added;
+    }
+
+    size_t HistoryStore::ReadLast(size_t count, vector<LoggedMessage> &out) const {
+        auto next = NextSeq();
+        return ReadAfter(next > count + 1 ? next - count - 1 : 0, count, out);
+    }
+
+    unsigned long long HistoryStore::FirstSeq() const {
+        return Segments.empty() ? NextSeq() : Segments.front().FirstSeq;
+    }
+
+    unsigned long long HistoryStore::NextSeq() const {
+        return Segments.empty() ? 1 : Segments.back().FirstSeq + Segments.back().Count;
+    }
+
+    size_t HistoryStore::SegmentCount() const {
+        return Segments.size();
+    }
+
+    size_t HistoryStore::Load() {
+        Release();
+        Failed = false;
+        vector<unsigned long long> firstSeqs;
+        error_code ec;
+        for (auto &entry: filesystem::directory_iterator(Directory(), ec)) {
+            if (entry.path().extension() != ".seg")
+                continue;
+            try {
+                firstSeqs.push_back(stoull(entry.path().stem().string()));
+            } catch (const exception &) {}
+        }
+        sort(firstSeqs.begin(), firstSeqs.end());
+
+        size_t total = 0;
+        for (auto first: firstSeqs) {
+            auto path = Directory() + "/" + to_string(first) + ".seg";
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd == -1)
+                continue;
+            struct stat info{};
+            void *base = MAP_FAILED;
+            if (fstat(fd, &info) == 0 && (size_t) info.st_size >= sizeof(RecordHeader))
+                base = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (base == MAP_FAILED)
+                continue;
+
+            Segment segment{first, 0, static_cast<char *>(base), (size_t) info.st_size, 0, nullptr, false, {}};
+            // The unused tail of a segment is zeroes, and no record has sequence number 0
+            while (segment.Used + sizeof(RecordHeader) <= segment.Capacity) {
+                auto header = reinterpret_cast<const RecordHeader *>(segment.Base + segment.Used);
+                if (header->Seq != first + segment.Count ||
+                    segment.Used + RecordSize(header->Length) > segment.Capacity)
+                    break;
+                if (segment.Count % IndexInterval == 0)
+                    segment.Index.push_back(static_cast<uint32_t>(segment.Used));
+                segment.Used += RecordSize(header->Length);
+                segment.Count++;
+            }
+            if (segment.Count == 0 || (!Segments.empty() && first < NextSeq())) {
+                munmap(segment.Base, segment.Capacity);
+                continue;
+            }
+            segment.Map = make_shared<Mapping>(segment.Base, segment.Capacity);
+            total += segment.Count;
+            Segments.push_back(move(segment));
+        }
+        // Already on disk
+        SyncedSegments = Segments.size();
+        return total;
+    }
+
+    void HistoryStore::Drop() {
+        Release();
+        error_code ec;
+        filesystem::remove_all(Directory(), ec);
+    }
+
+    void HistoryStore::CollectUnsynced(vector<pair<shared_ptr<Mapping>, size_t>> &out) {
+        for (size_t i = SyncedSegments; i < Segments.size(); i++)
+            out.emplace_back(Segments[i].Map, Segments[i].Used);
+        SyncedSegments = Segments.size();
+        if (!Segments.empty() && Segments.back().Active)
+            SyncedSegments--;
+    }
+
+    string HistoryStore::Directory() const {
+        return string(DefaultRoot) + "/" + to_string(RoomID);
+    }
+
+    bool HistoryStore::StartSegment(unsigned long long firstSeq, size_t recordSize) {
+        error_code ec;
+        filesystem::create_directories(Directory(), ec);
+
+        auto path = Directory() + "/" + to_string(firstSeq) + ".seg";
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd == -1 && errno == EEXIST) {
+            // A segment Load() could not use, keep it aside rather than write over it
+            filesystem::rename(path, path + ".stale", ec);
+            fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        }
+        if (fd == -1) {
+            perror("history segment open");
+            return false;
+        }
+        auto capacity = max(SegmentBytes, recordSize);
+        void *base = MAP_FAILED;
+        if (ftruncate(fd, static_cast<off_t>(capacity)) == 0)
+            base = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        // The mapping keeps the file alive and msync() works on it, the descriptor is not needed past this
+        close(fd);
+        if (base == MAP_FAILED) {
+            perror("history segment map");
+            return false;
+        }
+        auto map = make_shared<Mapping>(static_cast<char *>(base), capacity);
+        Segments.push_back(Segment{firstSeq, 0, map->Base, capacity, 0, move(map), true, {}});
+        return true;
+    }
+
+    void HistoryStore::Seal(Segment &segment) {
+        // Same mapping, so views into it stay valid
+        mprotect(segment.Base, segment.Capacity, PROT_READ);
+        segment.Active = false;
+        segment.Index.shrink_to_fit();
+    }
+
+    void HistoryStore::Release() {
+        // Unmaps whatever a snapshot isn't still syncing
+        Segments.clear();
+        SyncedSegments = 0;
+    }
+
+    vector<HistoryStore::Segment>::const_iterator HistoryStore::Locate(unsigned long long seq) const {
+        auto it = upper_bound(Segments.begin(), Segments.end(), seq,
+                              [](unsigned long long value, const Segment &segment) {
+                                  return value < segment.FirstSeq;
+                              });
+        if (it != Segments.begin() && seq - prev(it)->FirstSeq < prev(it)->Count)
+            --it;
+        return it;
+    }
+
+    size_t HistoryStore::OffsetOf(const Segment &segment, size_t pos) {
+        if (pos >= segment.Count)
+            return segment.Used;
+        size_t offset = segment.Index[pos / IndexInterval];
+        for (auto hops = pos % IndexInterval; hops > 0; hops--)
+            offset += RecordSize(reinterpret_cast<const RecordHeader *>(segment.Base + offset)->Length);
+        return offset;
+    }
+
+    size_t HistoryStore::RecordSize(size_t length) {
+        // Keeps every header 8-byte aligned
+        return (sizeof(RecordHeader) + length + 7) & ~size_t(7);
+    }
+
+    LoggedMessage HistoryStore::View(const Segment &segment, size_t offset) {
+        auto header = reinterpret_cast<const RecordHeader *>(segment.Base + offset);
+        return LoggedMessage{header->Seq, header->SenderID,
+                             string_view(segment.Base + offset + sizeof(RecordHeader), header->Length)};
+    }
+} // namespace classes::server_side
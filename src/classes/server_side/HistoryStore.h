@@ -0,0 +1,129 @@
+#ifndef CHAT2_HISTORYSTORE_H
+#define CHAT2_HISTORYSTORE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <cstdint>
+
+#include "MessageLog.h"
+
+using namespace std;
+
+namespace classes::server_side {
+    /**
+     * On-disk history of one room, behind the in-memory MessageLog. Messages go into fixed-size segment files,
+     * history/<roomID>/<firstSeq>.seg, that are memory-mapped for their whole life: writable while they are the
+     * active segment, read-only once sealed. The descriptor is closed right after mapping, a room holds no fds. A read is a binary search over the segments, one step in the
+     * segment's sparse index and a few pointer hops; the returned content points into the mapping, so old
+     * segments cost nothing but page cache. Not thread safe, the owner synchronises.
+     */
+    class HistoryStore {
+    public:
+        static constexpr const char *DefaultRoot = "history";
+        static constexpr size_t SegmentBytes = 1 << 20;
+        // Every IndexInterval-th record of a segment has its offset indexed
+        static constexpr size_t IndexInterval = 32;
+
+        /**
+         * One segment's mmap, unmapped when the last owner lets go. CollectUnsynced() hands out owners, so a range
+         * being msync'd stays mapped even if the room is dropped meanwhile.
+         */
+        struct Mapping {
+            char *Base;
+            size_t Length;
+
+            Mapping(char *base, size_t length);
+            ~Mapping();
+            Mapping(const Mapping &) = delete;
+            Mapping &operator=(const Mapping &) = delete;
+        };
+
+        explicit HistoryStore(unsigned long long rID = 0);
+        ~HistoryStore();
+        HistoryStore(HistoryStore &&other) noexcept;
+        HistoryStore &operator=(HistoryStore &&other) noexcept;
+        HistoryStore(const HistoryStore &) = delete;
+        HistoryStore &operator=(const HistoryStore &) = delete;
+
+        /**
+         * Sequence numbers below NextSeq() are already stored and ignored, a jump past it starts a new segment.
+         */
+        void Append(unsigned long long seq, unsigned long long senderID, string_view content);
+        /**
+         * The returned content stays valid until Drop() or the store is destroyed.
+         */
+        bool Read(unsigned long long seq, LoggedMessage &out) const;
+        /**
+         * Up to maxCount messages with a sequence number above afterSeq, oldest first. Returns how many were added.
+         */
+        size_t ReadAfter(unsigned long long afterSeq, size_t maxCount, vector<LoggedMessage> &out) const;
+        size_t ReadLast(size_t count, vector<LoggedMessage> &out) const;
+
+        unsigned long long FirstSeq() const;
+        unsigned long long NextSeq() const;
+        size_t SegmentCount() const;
+
+        /**
+         * Maps the segments a previous run left on disk, returns how many messages they hold.
+         */
+        size_t Load();
+        /**
+         * Unmaps every segment and deletes the room's files. The only place files are removed, a room whose
+         * history failed to load keeps them.
+         */
+        void Drop();
+        /**
+         * Appends the written parts of segments that may not be on disk yet, for the caller to msync() without
+         * holding the owner's lock. A sealed segment is handed out once, the active one every time.
+         */
+        void CollectUnsynced(vector<pair<shared_ptr<Mapping>, size_t>> &out);
+    private:
+        // Host byte order, 8-byte aligned in the segment and followed by the content
+        struct RecordHeader {
+            uint64_t Seq;
+            uint64_t SenderID;
+            uint32_t Length;
+            uint32_t Reserved;
+        };
+
+        struct Segment {
+            unsigned long long FirstSeq;
+            size_t Count;
+            char *Base;
+            size_t Capacity;
+            size_t Used;
+            // Owns Base..Base+Capacity
+            shared_ptr<Mapping> Map;
+            // Still being appended to and writable, false once sealed
+            bool Active;
+            // Offset of record FirstSeq + i * IndexInterval
+            vector<uint32_t> Index;
+        };
+
+        unsigned long long RoomID;
+        vector<Segment> Segments;
+        // Leading segments that are sealed and already handed out by CollectUnsynced()
+        size_t SyncedSegments;
+        bool Failed;
+
+        string Directory() const;
+        bool StartSegment(unsigned long long firstSeq, size_t recordSize);
+        void Seal(Segment &segment);
+        void Release();
+        /**
+         * First segment that holds seq or starts after it.
+         */
+        vector<Segment>::const_iterator Locate(unsigned long long seq) const;
+        /**
+         * Offset of the segment's pos-th record: the indexed record before it, then pointer hops.
+         */
+        static size_t OffsetOf(const Segment &segment, size_t pos);
+        static size_t RecordSize(size_t length);
+        static LoggedMessage View(const Segment &segment, size_t offset);
+    };
+} // namespace classes::server_side
+
+#endif //CHAT2_HISTORYSTORE_H
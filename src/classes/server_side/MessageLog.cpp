@@ -0,0 +1,71 @@
+#include "MessageLog.h"
+
+#include <algorithm>
+
+namespace classes::server_side {
+    MessageLog::MessageLog(size_t retainedChunks) :
+            Next(1), RetainedChunks(retainedChunks ? retainedChunks : 1) {}
+
+    unsigned long long MessageLog::Append(unsigned long long senderID, string_view content) {
+        if (Chunks.empty() || Chunks.back()->Count == RecordsPerChunk) {
+            unique_ptr<Chunk> chunk;
+            if (Spare) {
+                chunk = move(Spare);
+                chunk->Text.clear();
+            } else {
+                chunk = make_unique<Chunk>();
+            }
+            chunk->FirstSeq = Next;
+            chunk->Count = 0;
+            Chunks.push_back(move(chunk));
+            Trim();
+        }
+
+        auto &chunk = *Chunks.back();
+        chunk.Records[chunk.Count++] = Record{senderID, (uint32_t) chunk.Text.size(), (uint32_t) content.size()};
+        chunk.Text.append(content);
+        return Next++;
+    }
+
+    bool MessageLog::Read(unsigned long long seq, LoggedMessage &out) const {
+        if (seq < FirstSeq() || seq >= Next)
+            return false;
+        // Every chunk but the last is full, so the position is plain arithmetic
+        auto pos = seq - Chunks.front()->FirstSeq;
+        auto &chunk = *Chunks[pos / RecordsPerChunk];
+        auto &record = chunk.Records[pos % RecordsPerChunk];
+        out.Seq = seq;
+        out.SenderID = record.SenderID;
+        out.Content = string_view(chunk.Text.data() + record.Offset, record.Length);
+        return true;
+    }
+
+    unsigned long long MessageLog::FirstSeq() const {
+        return Chunks.empty() ? Next : Chunks.front()->FirstSeq;
+    }
+
+    unsigned long long MessageLog::NextSeq() const {
+        return Next;
+    }
+
+    size_t MessageLog::Size() const {
+        return Next - FirstSeq();
+    }
+
+    void MessageLog::SetRetention(size_t retainedChunks) {
+        RetainedChunks = retainedChunks ? retainedChunks : 1;
+        Trim();
+    }
+
+    void MessageLog::Resume(unsigned long long nextSeq) {
+        if (Chunks.empty())
+            Next = max(Next, nextSeq);
+    }
+
+    void MessageLog::Trim() {
+        while (Chunks.size() > RetainedChunks) {
+            Spare = move(Chunks.front());
+            Chunks.pop_front();
+        }
+    }
+} // namespace classes::server_side
@@ -0,0 +1,80 @@
+#ifndef CHAT2_MESSAGELOG_H
+#define CHAT2_MESSAGELOG_H
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <memory>
+#include <cstdint>
+
+using namespace std;
+
+namespace classes::server_side {
+    struct LoggedMessage {
+        unsigned long long Seq;
+        unsigned long long SenderID;
+        string_view Content;
+    };
+
+    /**
+     * Append-only message history. Messages get consecutive sequence numbers starting at 1 and are stored in
+     * fixed-size chunks of compact records, with the text of a chunk packed into one arena. Only the newest
+     * RetainedChunks chunks are kept, older ones are dropped whole and their memory reused, so a busy room's
+     * history stays bounded. Not thread safe, the owner synchronises.
+     */
+    class MessageLog {
+    public:
+        static constexpr size_t RecordsPerChunk = 256;
+        static constexpr size_t DefaultRetainedChunks = 16;
+
+        explicit MessageLog(size_t retainedChunks = DefaultRetainedChunks);
+        MessageLog(MessageLog &&) noexcept = default;
+        MessageLog &operator=(MessageLog &&) noexcept = default;
+
+        /**
+         * Returns the sequence number given to the message.
+         */
+        unsigned long long Append(unsigned long long senderID, string_view content);
+        /**
+         * Looks a message up by sequence number. Fails if it was never written or already fell out of retention.
+         * The returned content stays valid until the next Append().
+         */
+        bool Read(unsigned long long seq, LoggedMessage &out) const;
+
+        /**
+         * Oldest retained sequence number, equal to NextSeq() while the log is empty.
+         */
+        unsigned long long FirstSeq() const;
+        unsigned long long NextSeq() const;
+        size_t Size() const;
+
+        void SetRetention(size_t retainedChunks);
+        /**
+         * Continues numbering at nextSeq after a restart, the older messages are in the history store. Only while
+         * the log is empty.
+         */
+        void Resume(unsigned long long nextSeq);
+    private:
+        struct Record {
+            unsigned long long SenderID;
+            uint32_t Offset;
+            uint32_t Length;
+        };
+
+        struct Chunk {
+            unsigned long long FirstSeq;
+            size_t Count;
+            Record Records[RecordsPerChunk];
+            string Text;
+        };
+
+        deque<unique_ptr<Chunk>> Chunks;
+        unique_ptr<Chunk> Spare;
+        unsigned long long Next;
+        size_t RetainedChunks;
+
+        void Trim();
+    };
+} // namespace classes::server_side
+
+#endif //CHAT2_MESSAGELOG_H
@@ -0,0 +1,209 @@
+#include "OutboundQueue.h"
+#include "util/SlabPool.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+namespace classes::server_side {
+    atomic<unsigned long long> OutboundQueue::DroppedTotal = 0;
+    atomic<unsigned long long> OutboundQueue::SkippedTotal = 0;
+
+    OutboundQueue::OutboundQueue(size_t capacity) :
+            Capacity(2), RoomLimit(0), Cells(nullptr), EnqueuePos(0), DequeuePos(0), DroppedCount(0), Parked(false),
+            Interrupted(false), WakeFD(-1), SkippingAhead(false) {
+        while (Capacity < capacity)
+            Capacity <<= 1;
+        // Keep a quarter of the ring for responses once room messages are being skipped
+        RoomLimit = Capacity - Capacity / 4;
+    }
+
+    OutboundQueue::~OutboundQueue() {
+        delete[] Cells.load();
+        if (WakeFD.load() != -1)
+            close(WakeFD.load());
+    }
+
+    bool OutboundQueue::Push(util::FrameRef frame) {
+        if (frame.Room() != util::NoRoom &&
+            (SkippingAhead.load(memory_order_acquire) || Depth() >= RoomLimit)) {
+            RecordSkip(frame);
+            return false;
+        }
+        Cell *cells = Ring();
+        size_t pos = EnqueuePos.load(memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells[pos & (Capacity - 1)];
+            size_t seq = cell->Sequence.load(memory_order_acquire);
+            auto diff = (intptr_t) seq - (intptr_t) pos;
+            if (diff == 0) {
+                // Sequentially consistent so a consumer that parks after this cannot miss it, see Park()
+                if (EnqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_seq_cst, memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                DroppedCount.fetch_add(1, memory_order_relaxed);
+                DroppedTotal.fetch_add(1, memory_order_relaxed);
+                return false;
+            } else {
+                pos = EnqueuePos.load(memory_order_relaxed);
+            }
+        }
+        cell->Frame = move(frame);
+        cell->Sequence.store(pos + 1, memory_order_release);
+
+        if (Parked.exchange(false))
+            Wake();
+        return true;
+    }
+
+    util::FrameRef OutboundQueue::Pop() {
+        Cell *cell = Front();
+        if (!cell)
+            return {};
+        return Take(cell);
+    }
+
+    size_t OutboundQueue::Depth() const {
+        auto enqueued = EnqueuePos.load();
+        auto dequeued = DequeuePos.load();
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+    unsigned long long OutboundQueue::Dropped() const {
+        return DroppedCount.load(memory_order_relaxed);
+    }
+
+    unsigned long long OutboundQueue::TotalDropped() {
+        return DroppedTotal.load(memory_order_relaxed);
+    }
+
+    vector<OutboundQueue::SkippedRange> OutboundQueue::TakeSkipped() {
+        if (CaughtUp.empty())
+            return {};
+        return exchange(CaughtUp, {});
+    }
+
+    unsigned long long OutboundQueue::TotalSkipped() {
+        return SkippedTotal.load(memory_order_relaxed);
+    }
+
+    int OutboundQueue::WakeHandle() {
+        if (WakeFD.load() == -1)
+            WakeFD.store(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+        return WakeFD.load();
+    }
+
+    bool OutboundQueue::Park() {
+        // Drained before announcing the park, a wake written after that must still be there for select()
+        uint64_t pending;
+        while (read(WakeHandle(), &pending, sizeof(pending)) > 0) {}
+        // Pairs with the seq_cst enqueue in Push(): either the producer sees Parked or we see its frame
+        Parked.store(true);
+        if (Depth() > 0 || Interrupted.exchange(false)) {
+            Parked.store(false);
+            return false;
+        }
+        return true;
+    }
+
+    void OutboundQueue::Interrupt() {
+        Interrupted.store(true);
+        if (Parked.exchange(false))
+            Wake();
+    }
+
+    OutboundQueue::Cell *OutboundQueue::Ring() {
+        Cell *cells = Cells.load(memory_order_acquire);
+        if (cells)
+            return cells;
+        auto fresh = new Cell[Capacity];
+        for (size_t i = 0; i < Capacity; i++)
+            fresh[i].Sequence.store(i, memory_order_relaxed);
+        if (Cells.compare_exchange_strong(cells, fresh, memory_order_acq_rel))
+            return fresh;
+        // Another producer allocated first
+        delete[] fresh;
+        return cells;
+    }
+
+    OutboundQueue::Cell *OutboundQueue::Front() {
+        Cell *cells = Cells.load(memory_order_acquire);
+        if (!cells)
+            return nullptr;
+        while (true) {
+            size_t pos = DequeuePos.load(memory_order_relaxed);
+            Cell *cell = &cells[pos & (Capacity - 1)];
+            if (cell->Sequence.load(memory_order_acquire) != pos + 1) {
+                if (SkippingAhead.load(memory_order_acquire))
+                    EndSkip();
+                return nullptr;
+            }
+            if (cell->Frame.Room() == util::NoRoom || !SkippingAhead.load(memory_order_acquire))
+                return cell;
+            // Skipping ahead: the client fetches this one from history instead
+            RecordSkip(Take(cell));
+        }
+    }
+
+    util::FrameRef OutboundQueue::Take(Cell *cell) {
+        auto frame = move(cell->Frame);
+        size_t pos = DequeuePos.load(memory_order_relaxed);
+        cell->Sequence.store(pos + Capacity, memory_order_release);
+        DequeuePos.store(pos + 1, memory_order_release);
+        return frame;
+    }
+
+    void OutboundQueue::Wake() {
+        uint64_t one = 1;
+        auto fd = WakeFD.load();
+        if (fd != -1)
+            (void) !write(fd, &one, sizeof(one));
+    }
+
+    void OutboundQueue::RecordSkip(const util::FrameRef &frame) {
+        {
+            //Critical Section
+            lock_guard<mutex> guard(m_Skipped);
+            SkippingAhead.store(true, memory_order_release);
+            auto it = SkippedRooms.find(frame.Room());
+            if (it == SkippedRooms.end()) {
+                SkippedRooms.emplace(frame.Room(), SkippedRange{frame.Room(), frame.Seq(), frame.Seq()});
+            } else {
+                it->second.FirstSeq = min(it->second.FirstSeq, frame.Seq());
+                it->second.LastSeq = max(it->second.LastSeq, frame.Seq());
+            }
+        }
+        SkippedTotal.fetch_add(1, memory_order_relaxed);
+    }
+
+    void OutboundQueue::EndSkip() {
+        {
+            //Critical Section
+            lock_guard<mutex> guard(m_Skipped);
+            // A producer may still be publishing into a claimed cell, try again on the next pop
+            if (Depth() > 0)
+                return;
+            SkippingAhead.store(false, memory_order_release);
+            for (auto &[room, range]: SkippedRooms)
+                CaughtUp.push_back(range);
+            SkippedRooms.clear();
+        }
+    }
+
+    void *OutboundQueue::operator new(size_t size) {
+        if (size != sizeof(OutboundQueue))
+            return ::operator new(size);
+        return util::SlabPool<sizeof(OutboundQueue), alignof(OutboundQueue)>::Instance().Allocate();
+    }
+
+    void OutboundQueue::operator delete(void *ptr, size_t size) {
+        if (size != sizeof(OutboundQueue)) {
+            ::operator delete(ptr);
+            return;
+        }
+        util::SlabPool<sizeof(OutboundQueue), alignof(OutboundQueue)>::Instance().Deallocate(ptr);
+    }
+} // namespace classes::server_side
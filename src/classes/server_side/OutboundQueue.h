@@ -0,0 +1,131 @@
+#ifndef CHAT2_OUTBOUNDQUEUE_H
+#define CHAT2_OUTBOUNDQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "util/FramePool.h"
+
+using namespace std;
+
+namespace classes::server_side {
+    /**
+     * Frames waiting to be sent on one client's connection: a bounded multi-producer, single-consumer ring
+     * (per-cell sequence numbers, no locks). Any thread may push, only the connection thread pops.
+     * When the ring is full the new frame is dropped and counted, the queued frames are kept. The cells are only
+     * allocated on the first push, so clients that never receive anything cost no ring.
+     *
+     * The ring is lock-free but not wait-free: producers claim a cell with a CAS on EnqueuePos and retry when
+     * another producer claimed it first, so under contention one push can loop while others make progress.
+     *
+     * Room messages have a lower limit than the ring itself. A consumer that falls behind it is skipped ahead: the
+     * room messages still queued are discarded as the consumer reaches them, new ones are refused until it has
+     * caught up, and the skipped seq ranges are handed back so the client can fetch them from the room's history.
+     * The skipped ranges sit behind m_Skipped. Only pushes to a queue that is already skipping take it, the ring
+     * itself never does; per-room atomics would race the consumer's hand-back against a producer widening the
+     * same range, and could lose seqs the client then never fetches.
+     */
+    class OutboundQueue {
+    public:
+        static constexpr size_t DefaultCapacity = 512;
+
+        struct SkippedRange {
+            unsigned long long Room;
+            unsigned long long FirstSeq;
+            unsigned long long LastSeq;
+        };
+
+        explicit OutboundQueue(size_t capacity = DefaultCapacity);
+        ~OutboundQueue();
+        OutboundQueue(const OutboundQueue &) = delete;
+        OutboundQueue &operator=(const OutboundQueue &) = delete;
+
+        /**
+         * Returns false if the frame was dropped: the ring was full, or it is a room message and the queue is past
+         * its room message limit.
+         */
+        bool Push(util::FrameRef frame);
+        /**
+         * Returns an empty FrameRef when nothing is waiting. Consumer only.
+         */
+        util::FrameRef Pop();
+        /**
+         * Pops the oldest frame only if `accept` returns true for it, so frames are never taken out of order.
+         * Consumer only.
+         */
+        template<typename P>
+        util::FrameRef PopIf(P accept) {
+            Cell *cell = Front();
+            if (!cell || !accept(cell->Frame))
+                return {};
+            return Take(cell);
+        }
+        size_t Depth() const;
+        unsigned long long Dropped() const;
+        /**
+         * Frames dropped on full rings across all queues.
+         */
+        static unsigned long long TotalDropped();
+        /**
+         * Skipped room message ranges, one per room, available once the skip-ahead has caught up. Consumer only.
+         */
+        vector<SkippedRange> TakeSkipped();
+        /**
+         * Room messages skipped ahead across all queues.
+         */
+        static unsigned long long TotalSkipped();
+
+        /**
+         * Descriptor that becomes readable once a frame is pushed after the consumer called Park(). Lets the
+         * connection thread wait for outbound frames and inbound data in the same select(). The eventfd is created
+         * on the first call, so only queues a connection thread waits on hold one, it is closed with the queue.
+         */
+        int WakeHandle();
+        /**
+         * Consumer announces it is about to wait on WakeHandle(). Returns false if frames are already waiting.
+         */
+        bool Park();
+        /**
+         * Wakes a consumer parked on WakeHandle(), or keeps its next Park() from waiting. Used when the connection
+         * thread has to move on to another client's queue.
+         */
+        void Interrupt();
+
+        static void *operator new(size_t size);
+        static void operator delete(void *ptr, size_t size);
+    private:
+        struct Cell {
+            atomic<size_t> Sequence;
+            util::FrameRef Frame;
+        };
+
+        size_t Capacity;
+        size_t RoomLimit;
+        atomic<Cell *> Cells;
+        atomic<size_t> EnqueuePos;
+        atomic<size_t> DequeuePos;
+        atomic<unsigned long long> DroppedCount;
+        atomic<bool> Parked;
+        atomic<bool> Interrupted;
+        atomic<int> WakeFD;
+        atomic<bool> SkippingAhead;
+        mutex m_Skipped;
+        unordered_map<unsigned long long, SkippedRange> SkippedRooms;
+        vector<SkippedRange> CaughtUp;
+
+        static atomic<unsigned long long> DroppedTotal;
+        static atomic<unsigned long long> SkippedTotal;
+
+        Cell *Ring();
+        Cell *Front();
+        util::FrameRef Take(Cell *cell);
+        void Wake();
+        void RecordSkip(const util::FrameRef &frame);
+        void EndSkip();
+    };
+} // namespace classes::server_side
+
+#endif //CHAT2_OUTBOUNDQUEUE_H
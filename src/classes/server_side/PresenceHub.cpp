@@ -0,0 +1,115 @@
+#include "PresenceHub.h"
+#include "FrameEncoder.h"
+
+#include <string>
+
+namespace classes::server_side {
+    PresenceHub::PresenceHub(Deliver deliver, chrono::milliseconds interval) :
+            DeliverFn(move(deliver)), Interval(interval), CoalescedCount(0), Stopping(false) {
+        Flusher = thread([this]() { Run(); });
+    }
+
+    PresenceHub::~PresenceHub() {
+        {
+            lock_guard<mutex> guard(m_Pending);
+            Stopping = true;
+        }
+        StopCV.notify_all();
+        if (Flusher.joinable())
+            Flusher.join();
+    }
+
+    void PresenceHub::Publish(const vector<unsigned long long> &recipients, const PresenceEntry &entry) {
+        {
+            //Critical Section
+            lock_guard<mutex> guard(m_Pending);
+            for (auto recipient: recipients)
+                if (!Merge(PendingUpdates[recipient], entry, true))
+                    CoalescedCount.fetch_add(1, memory_order_relaxed);
+        }
+    }
+
+    size_t PresenceHub::Pending() const {
+        {
+            //Critical Section
+            lock_guard<mutex> guard(m_Pending);
+            return PendingUpdates.size();
+        }
+    }
+
+    unsigned long long PresenceHub::Coalesced() const {
+        return CoalescedCount.load(memory_order_relaxed);
+    }
+
+    void PresenceHub::Run() {
+        unique_lock<mutex> lock(m_Pending);
+        while (!StopCV.wait_for(lock, Interval, [this]() { return Stopping; })) {
+            if (PendingUpdates.empty())
+                continue;
+            lock.unlock();
+            Flush();
+            lock.lock();
+        }
+    }
+
+    void PresenceHub::Flush() {
+        unordered_map<unsigned long long, vector<PresenceEntry>> ready;
+        {
+            //Critical Section
+            lock_guard<mutex> guard(m_Pending);
+            ready.swap(PendingUpdates);
+        }
+        vector<util::FrameRef> frames;
+        for (auto &[recipient, entries]: ready) {
+            frames.clear();
+            Encode(entries, frames);
+            if (DeliverFn(recipient, frames))
+                continue;
+            // Recipient is busy, park the states again unless something newer came in meanwhile
+            {
+                //Critical Section
+                lock_guard<mutex> guard(m_Pending);
+                auto &parked = PendingUpdates[recipient];
+                for (auto &entry: entries)
+                    Merge(parked, entry, false);
+            }
+        }
+    }
+
+    bool PresenceHub::Merge(vector<PresenceEntry> &into, const PresenceEntry &entry, bool replace) {
+        for (auto &cur: into) {
+            if (cur.SubjectID != entry.SubjectID || cur.Room != entry.Room)
+                continue;
+            if (replace)
+                cur.State = entry.State;
+            return false;
+        }
+        into.push_back(entry);
+        return true;
+    }
+
+    void PresenceHub::Encode(const vector<PresenceEntry> &entries, vector<util::FrameRef> &out) {
+        // Type and empty address, then the widest count a frame can have
+        static const size_t header = FrameEncoder::Encode(ClientActionType::PresenceUpdate, {}).Size();
+        const size_t overhead = header + to_string(entries.size()).size() + 1;
+        string body, record;
+        size_t count = 0;
+        for (auto &entry: entries) {
+            record = to_string(entry.SubjectID);
+            record += ' ';
+            record += to_string(static_cast<int>(entry.State));
+            record += ' ';
+            record += entry.Room == util::NoRoom ? string("*") : to_string(entry.Room);
+            record += ' ';
+            if (count > 0 && overhead + body.size() + record.size() > MaxFrameBytes) {
+                out.push_back(FrameEncoder::Encode(ClientActionType::PresenceUpdate, to_string(count) + " " + body));
+                body.clear();
+                count = 0;
+            }
+            body += record;
+            count++;
+        }
+        if (count > 0)
+            out.push_back(FrameEncoder::Encode(ClientActionType::PresenceUpdate, to_string(count) + " " + body));
+    }
+} // namespace classes::server_side
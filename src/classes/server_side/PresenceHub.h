@@ -0,0 +1,84 @@
+#ifndef CHAT2_PRESENCEHUB_H
+#define CHAT2_PRESENCEHUB_H
+
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+#include "../general/Enums.h"
+#include "util/FramePool.h"
+
+using namespace std;
+using namespace classes::general;
+
+namespace classes::server_side {
+    /**
+     * One presence or typing state. Room is util::NoRoom for online/offline, which is not tied to a room.
+     */
+    struct PresenceEntry {
+        unsigned long long SubjectID;
+        unsigned long long Room;
+        PresenceState State;
+    };
+
+    /**
+     * Low-priority presence stream. Updates are parked per recipient, where a newer state for the same
+     * (subject, room) replaces the older one, and flushed on the hub's own thread at most once per interval as
+     * PresenceUpdate frames of at most MaxFrameBytes each. Deliver decides whether the recipient can take it right now; a
+     * refused update stays parked for the next tick, so presence never queues in front of chat messages.
+     */
+    class PresenceHub {
+    public:
+        /**
+         * Called on the hub's thread with all of a recipient's frames. Returns false to keep the updates parked.
+         */
+        using Deliver = function<bool(unsigned long long recipient, const vector<util::FrameRef> &frames)>;
+
+        static constexpr chrono::milliseconds DefaultInterval{250};
+        // Clients read a frame with a single 1 KiB recv()
+        static constexpr size_t MaxFrameBytes = 1000;
+
+        explicit PresenceHub(Deliver deliver, chrono::milliseconds interval = DefaultInterval);
+        ~PresenceHub();
+        PresenceHub(const PresenceHub &) = delete;
+        PresenceHub &operator=(const PresenceHub &) = delete;
+
+        void Publish(const vector<unsigned long long> &recipients, const PresenceEntry &entry);
+        /**
+         * Recipients with updates still parked.
+         */
+        size_t Pending() const;
+        /**
+         * Updates replaced by a newer state before they were sent.
+         */
+        unsigned long long Coalesced() const;
+    private:
+        Deliver DeliverFn;
+        chrono::milliseconds Interval;
+        mutable mutex m_Pending;
+        condition_variable StopCV;
+        unordered_map<unsigned long long, vector<PresenceEntry>> PendingUpdates;
+        atomic<unsigned long long> CoalescedCount;
+        bool Stopping;
+        thread Flusher;
+
+        void Run();
+        void Flush();
+        /**
+         * Adds the entry or, for a known (subject, room), replaces the state if `replace` is set.
+         */
+        bool Merge(vector<PresenceEntry> &into, const PresenceEntry &entry, bool replace);
+        /**
+         * PresenceUpdate frames, data is "<count> " then "<subjectID> <state> <roomID or *> " per entry. Entries
+         * are split across as many frames as it takes to keep each within MaxFrameBytes.
+         */
+        static void Encode(const vector<PresenceEntry> &entries, vector<util::FrameRef> &out);
+    };
+} // namespace classes::server_side
+
+#endif //CHAT2_PRESENCEHUB_H
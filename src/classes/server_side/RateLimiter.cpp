@@ -0,0 +1,81 @@
+#include "RateLimiter.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace classes::server_side {
+    const unsigned long long PruneInterval = 4096;
+
+    TokenBucket::TokenBucket() : Tokens(0), Rate(0), Burst(0), Last() {}
+
+    TokenBucket::TokenBucket(double rate, double burst) :
+            Tokens(burst), Rate(rate), Burst(burst), Last(chrono::steady_clock::now()) {}
+
+    void TokenBucket::Refill(TimePoint now) {
+        chrono::duration<double> elapsed = now - Last;
+        Last = now;
+        Tokens = min(Burst, Tokens + elapsed.count() * Rate);
+    }
+
+    unsigned long long TokenBucket::RetryAfter() const {
+        if (Tokens >= 1)
+            return 0;
+        if (Rate <= 0)
+            return 1000;
+        return (unsigned long long) ceil((1 - Tokens) / Rate * 1000);
+    }
+
+    RateLimiter::RateLimiter() : RateLimiter(RateLimits{}) {}
+
+    RateLimiter::RateLimiter(RateLimits limits) : Limits(limits), AdmitCount(0) {}
+
+    unsigned long long RateLimiter::Admit(unsigned long long clientID, const string &address,
+                                          bool hasRoom, unsigned long long roomID) {
+        auto now = chrono::steady_clock::now();
+        {
+            //Critical Section
+            lock_guard<mutex> guard(m_Buckets);
+            if (++AdmitCount % PruneInterval == 0)
+                Prune(now);
+
+            auto &client = ClientBuckets.try_emplace(clientID, Limits.ClientRate, Limits.ClientBurst).first->second;
+            auto &addr = AddressBuckets.try_emplace(address, Limits.AddressRate, Limits.AddressBurst).first->second;
+            TokenBucket *room = nullptr;
+            if (hasRoom)
+                room = &RoomBuckets.try_emplace(roomID, Limits.RoomRate, Limits.RoomBurst).first->second;
+
+            client.Refill(now);
+            addr.Refill(now);
+            if (room)
+                room->Refill(now);
+
+            unsigned long long wait = max(client.RetryAfter(), addr.RetryAfter());
+            if (room)
+                wait = max(wait, room->RetryAfter());
+            if (wait > 0)
+                return wait;
+
+            client.Tokens -= 1;
+            addr.Tokens -= 1;
+            if (room)
+                room->Tokens -= 1;
+            return 0;
+        }
+    }
+
+    void RateLimiter::Prune(TimePoint now) {
+        // A bucket that refilled to its burst carries no state worth keeping.
+        auto prune = [now](auto &buckets) {
+            for (auto it = buckets.begin(); it != buckets.end();) {
+                it->second.Refill(now);
+                if (it->second.Tokens >= it->second.Burst)
+                    it = buckets.erase(it);
+                else
+                    ++it;
+            }
+        };
+        prune(ClientBuckets);
+        prune(RoomBuckets);
+        prune(AddressBuckets);
+    }
+} // namespace classes::server_side
@@ -0,0 +1,65 @@
+#ifndef CHAT2_RATELIMITER_H
+#define CHAT2_RATELIMITER_H
+
+#include <string>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+
+using namespace std;
+
+namespace classes::server_side {
+    typedef chrono::steady_clock::time_point TimePoint;
+
+    struct TokenBucket {
+        double Tokens;
+        double Rate;
+        double Burst;
+        TimePoint Last;
+
+        TokenBucket();
+        TokenBucket(double rate, double burst);
+
+        void Refill(TimePoint now);
+        /**
+         * Milliseconds until one token is available, 0 if one is available now.
+         */
+        unsigned long long RetryAfter() const;
+    };
+
+    struct RateLimits {
+        double ClientRate = 20;
+        double ClientBurst = 40;
+        double RoomRate = 200;
+        double RoomBurst = 400;
+        double AddressRate = 60;
+        double AddressBurst = 120;
+    };
+
+    /**
+     * Token buckets per client, per room and per source address. A frame is admitted only if all of its buckets
+     * hold a token, in which case one token is taken from each.
+     */
+    class RateLimiter {
+    public:
+        RateLimiter();
+        explicit RateLimiter(RateLimits limits);
+
+        /**
+         * Returns 0 if the frame was admitted, otherwise the number of milliseconds the sender should wait.
+         */
+        unsigned long long Admit(unsigned long long clientID, const string &address,
+                                 bool hasRoom, unsigned long long roomID);
+    private:
+        RateLimits Limits;
+        mutex m_Buckets;
+        unordered_map<unsigned long long, TokenBucket> ClientBuckets;
+        unordered_map<unsigned long long, TokenBucket> RoomBuckets;
+        unordered_map<string, TokenBucket> AddressBuckets;
+        unsigned long long AdmitCount;
+
+        void Prune(TimePoint now);
+    };
+} // namespace classes::server_side
+
+#endif //CHAT2_RATELIMITER_H
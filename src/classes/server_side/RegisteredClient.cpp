@@ -1,76 +1,95 @@
 #include "RegisteredClient.h"
 #include "ClientConnection.h"
+#include "util/SlabPool.h"
 
 #include <utility>
 
 namespace classes::server_side {
-    unsigned long long RegisteredClient::count = 0;
+    atomic<unsigned long long> RegisteredClient::count = 0;
 
     RegisteredClient::RegisteredClient() {
-        Setup();
+        Setup(count++);
     }
 
     RegisteredClient::RegisteredClient(string name) :
-            DisplayName(std::move(name)) {
-        Setup();
+            DisplayName(util::Symbol::Intern(name)) {
+        Setup(count++);
+    }
+
+    RegisteredClient::RegisteredClient(unsigned long long id, string name) :
+            DisplayName(util::Symbol::Intern(name)) {
+        Setup(id);
+    }
+
+    shared_ptr<RegisteredClient> RegisteredClient::Create(string name) {
+        return util::MakePooled<RegisteredClient>(move(name));
+    }
+
+    shared_ptr<RegisteredClient> RegisteredClient::Restore(unsigned long long id, string name, string loginKey) {
+        auto client = util::MakePooled<RegisteredClient>(id, move(name));
+        client->LoginKey = move(loginKey);
+        return client;
+    }
+
+    unsigned long long RegisteredClient::NextID() {
+        return count.load();
+    }
+
+    void RegisteredClient::ResumeIDs(unsigned long long next) {
+        auto current = count.load();
+        while (current < next && !count.compare_exchange_weak(current, next)) {}
     }
 
     void RegisteredClient::PushResponse(ClientAction act) {
-        {
-            lock_guard<mutex> guard(*m_AwaitingResponses);
-            AwaitingResponses.push_back(move(act));
-        }
+        PushFrame(util::FramePool::FromString(act.Serialize(), static_cast<uint8_t>(act.ActionType)));
     }
 
-    ClientAction RegisteredClient::GetResponse() {
-        {
-            lock_guard<mutex> guard(*m_AwaitingResponses);
-            if (!AwaitingResponses.empty()) {
-                PoppedEmptyFlag = false;
-                auto tmp = move(AwaitingResponses.front());
-                AwaitingResponses.pop_back();
-                return tmp;
-            }
-            PoppedEmptyFlag = true;
-            return {};
-        }
+    void RegisteredClient::PushFrame(util::FrameRef frame) {
+        Outbound->Push(move(frame));
+    }
+
+    util::FrameRef RegisteredClient::GetResponse() {
+        return Outbound->Pop();
     }
 
-    void RegisteredClient::Setup() {
-        PoppedEmptyFlag = false;
-        ClientID = count++;
-        IsConnected = false;
-        m_AwaitingResponses = make_shared<mutex>();
+    void RegisteredClient::Setup(unsigned long long id) {
+        ClientID = id;
+        Slot = NoSlot;
+        SeenAnnouncement = 0;
+        Outbound = make_unique<OutboundQueue>();
     }
 
     RegisteredClient::RegisteredClient(RegisteredClient& other) {
         this->ClientID = other.ClientID;
         this->DisplayName = other.DisplayName;
-        this->IsConnected = other.IsConnected;
         this->Connection = move(other.Connection);
-        this->PoppedEmptyFlag = other.PoppedEmptyFlag;
-
-        this->m_AwaitingResponses = make_shared<mutex>();
-        lock_guard<mutex> guard(*other.m_AwaitingResponses);
-        this->AwaitingResponses = move(other.AwaitingResponses);
+        this->JoinedRooms = other.JoinedRooms;
+        this->Slot = NoSlot;
+        this->SeenAnnouncement = other.SeenAnnouncement;
+        this->MissedFrom = other.MissedFrom;
+        this->Coalescing = other.Coalescing;
+
+        this->Outbound = move(other.Outbound);
+        other.Outbound = make_unique<OutboundQueue>();
     }
 
     RegisteredClient::RegisteredClient(RegisteredClient&& other) noexcept {
         this->ClientID = other.ClientID;
-        this->DisplayName = std::move(other.DisplayName);
-        this->IsConnected = other.IsConnected;
+        this->DisplayName = other.DisplayName;
         this->Connection = std::move(other.Connection);
-        this->PoppedEmptyFlag = other.PoppedEmptyFlag;
-
-        this->m_AwaitingResponses = std::move(other.m_AwaitingResponses);
-        this->AwaitingResponses = std::move(other.AwaitingResponses);
+        this->JoinedRooms = std::move(other.JoinedRooms);
+        this->Outbound = std::move(other.Outbound);
+        this->Slot = other.Slot;
+        this->SeenAnnouncement = other.SeenAnnouncement;
+        this->MissedFrom = std::move(other.MissedFrom);
+        this->Coalescing = other.Coalescing;
 
         other.ClientID = -1;
-        other.PoppedEmptyFlag = false;
-        other.AwaitingResponses.clear();
-        other.IsConnected = false;
-        other.DisplayName.clear();
+        other.Slot = NoSlot;
+        other.DisplayName = {};
         other.LoginKey.clear();
+        other.JoinedRooms.clear();
+        other.MissedFrom.clear();
         other.Connection = nullptr;
     }
 
@@ -80,32 +99,41 @@ namespace classes::server_side {
         }
 
         this->ClientID = other.ClientID;
-        this->DisplayName = std::move(other.DisplayName);
-        this->IsConnected = other.IsConnected;
+        this->DisplayName = other.DisplayName;
         this->Connection = std::move(other.Connection);
-        this->PoppedEmptyFlag = other.PoppedEmptyFlag;
-
-        this->m_AwaitingResponses = std::move(other.m_AwaitingResponses);
-        this->AwaitingResponses = std::move(other.AwaitingResponses);
+        this->JoinedRooms = std::move(other.JoinedRooms);
+        this->Outbound = std::move(other.Outbound);
+        this->Slot = other.Slot;
+        this->SeenAnnouncement = other.SeenAnnouncement;
+        this->MissedFrom = std::move(other.MissedFrom);
+        this->Coalescing = other.Coalescing;
 
         other.ClientID = -1;
-        other.PoppedEmptyFlag = false;
-        other.AwaitingResponses.clear();
-        other.IsConnected = false;
-        other.DisplayName.clear();
+        other.Slot = NoSlot;
+        other.DisplayName = {};
         other.LoginKey.clear();
+        other.JoinedRooms.clear();
+        other.MissedFrom.clear();
         other.Connection = nullptr;
 
         return *this;
     }
 
-    void RegisteredClient::LinkClientConnection(unique_ptr<ClientConnection> conn) {
-        Connection = move(conn);
+    void RegisteredClient::LinkClientConnection(unique_ptr<ClientConnection> &conn) {
         auto self_shared = shared_from_this();  // Get a shared_ptr to this
+        auto link = conn.get();
+        auto hostLock = link->m_Host;
+        // The thread may be parked on the old host's queue, which nothing pushes to after the swap
+        link->Pause();
+        if (link->Host)
+            link->Host->Outbound->Interrupt();
         {
-            //lock_guard<mutex> guard(*Connection->m_Host);
+            //Critical Section
+            lock_guard<mutex> guard(*hostLock);
+            Connection = move(conn);
             Connection->Host = self_shared;
         }
+        link->Resume();
     }
 
     RegisteredClient::~RegisteredClient() {
@@ -5,9 +5,18 @@
 #include <vector>
 #include <mutex>
 #include <memory>
+#include <atomic>
+#include <unordered_set>
+#include <unordered_map>
+#include <cstdint>
 
 #include "../general/ClientAction.h"
 #include "../general/ServerAction.h"
+#include "util/FramePool.h"
+#include "util/StringTable.h"
+#include "OutboundQueue.h"
+#include "CoalescingWindow.h"
+#include "ClientTable.h"
 
 using namespace std;
 using namespace classes::general;
@@ -15,31 +24,71 @@ using namespace classes::general;
 namespace classes::server_side {
     class ClientConnection;
 
+    /**
+     * Cold record of a client. Its hot state (id, connected flag, outbound queue) is mirrored in the server's
+     * ClientTable at index Slot.
+     */
     class RegisteredClient : public enable_shared_from_this<RegisteredClient> {
     public:
         unsigned long long ClientID;
-        string DisplayName;
+        util::Symbol DisplayName;
         string LoginKey;
         unique_ptr<ClientConnection> Connection;
-        bool IsConnected;
-        bool PoppedEmptyFlag;
+        unordered_set<unsigned long long> JoinedRooms;
+        unique_ptr<OutboundQueue> Outbound;
+        // Only the connection thread serving this client touches it. Kept here rather than on the connection,
+        // which login moves to another client while that thread may be running.
+        CoalescingWindow Coalescing;
+        uint32_t Slot;
+        // Last server announcement this client has received, guarded by Server::m_Clients
+        unsigned long long SeenAnnouncement;
+        // Per joined room, the first message seq this client missed while offline. Drained at login, guarded by
+        // Server::m_Clients. One entry per room however many messages were missed.
+        unordered_map<unsigned long long, unsigned long long> MissedFrom;
 
         RegisteredClient();
         explicit RegisteredClient(string);
+        // Keeps an earlier ID, takes none from the counter
+        RegisteredClient(unsigned long long id, string name);
         ~RegisteredClient();
         RegisteredClient(RegisteredClient&);
         RegisteredClient(RegisteredClient&&) noexcept;
         RegisteredClient& operator=(RegisteredClient&&) noexcept;
 
-        void PushResponse(ClientAction);
-        void LinkClientConnection(unique_ptr<ClientConnection> conn);
-        ClientAction GetResponse();
+        /**
+         * Allocates the client and its control block in one block from a slab pool.
+         */
+        static shared_ptr<RegisteredClient> Create(string name);
+        /**
+         * Recreates an account from a snapshot or the WAL under its earlier ID. Safe to call from several threads.
+         */
+        static shared_ptr<RegisteredClient> Restore(unsigned long long id, string name, string loginKey);
+        /**
+         * ID the next client gets. ResumeIDs() makes sure IDs below next are never handed out again.
+         */
+        static unsigned long long NextID();
+        static void ResumeIDs(unsigned long long next);
 
-        shared_ptr<mutex> m_AwaitingResponses;
+        /**
+         * Encodes the action into a pooled frame and queues it.
+         */
+        void PushResponse(ClientAction);
+        /**
+         * Queues an already encoded frame, the same frame may sit in many clients' queues at once.
+         */
+        void PushFrame(util::FrameRef frame);
+        /**
+         * Takes conn over, leaving it empty. The move happens under the connection's host lock, so its thread
+         * never runs with a host whose Connection is half moved.
+         */
+        void LinkClientConnection(unique_ptr<ClientConnection> &conn);
+        /**
+         * Pops the oldest queued frame, or an empty FrameRef when nothing is waiting.
+         */
+        util::FrameRef GetResponse();
     private:
-        void Setup();
-        static unsigned long long count;
-        vector<ClientAction> AwaitingResponses;
+        void Setup(unsigned long long id);
+        static atomic<unsigned long long> count;
     };
 }
 
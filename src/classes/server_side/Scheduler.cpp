@@ -0,0 +1,122 @@
+#include "Scheduler.h"
+
+namespace classes::server_side {
+    void Scheduler::YieldAwaiter::await_suspend(coroutine_handle<> awaiting) {
+        Owner->Schedule(awaiting);
+    }
+
+    void Scheduler::OffloadAwaiter::await_suspend(coroutine_handle<> awaiting) {
+        Owner->RunOnWorker([owner = Owner, work = move(Work), awaiting]() {
+            work();
+            owner->Schedule(awaiting);
+        });
+    }
+
+    Scheduler::Scheduler(unsigned int workerCount) : Woken(false), Stopping(false) {
+        if (workerCount == 0)
+            workerCount = 1;
+        for (unsigned int i = 0; i < workerCount; i++) {
+            Workers.emplace_back([this]() {
+                while (true) {
+                    function<void()> job;
+                    {
+                        unique_lock<mutex> lock(m_Jobs);
+                        JobsCV.wait(lock, [this]() { return Stopping || !Jobs.empty(); });
+                        if (Jobs.empty())
+                            return;
+                        job = move(Jobs.front());
+                        Jobs.pop_front();
+                    }
+                    job();
+                }
+            });
+        }
+    }
+
+    Scheduler::~Scheduler() {
+        {
+            lock_guard<mutex> guard(m_Jobs);
+            Stopping = true;
+        }
+        JobsCV.notify_all();
+        for (auto &worker: Workers)
+            if (worker.joinable())
+                worker.join();
+        // Whatever is still suspended will never run again; release the frames.
+        lock_guard<mutex> guard(m_Ready);
+        for (auto &coroutine: Ready)
+            coroutine.destroy();
+        Ready.clear();
+    }
+
+    void Scheduler::Spawn(Task task) {
+        auto coroutine = task.Release();
+        if (!coroutine)
+            return;
+        coroutine.promise().Detached = true;
+        coroutine.resume();
+    }
+
+    void Scheduler::Schedule(coroutine_handle<> coroutine) {
+        {
+            //Critical Section
+            lock_guard<mutex> guard(m_Ready);
+            Ready.push_back(coroutine);
+        }
+        ReadyCV.notify_one();
+    }
+
+    size_t Scheduler::RunReady() {
+        deque<coroutine_handle<>> batch;
+        {
+            //Critical Section
+            lock_guard<mutex> guard(m_Ready);
+            if (Ready.empty())
+                return 0;
+            batch.swap(Ready);
+        }
+        for (auto &coroutine: batch)
+            coroutine.resume();
+        return batch.size();
+    }
+
+    bool Scheduler::HasReady() {
+        {
+            //Critical Section
+            lock_guard<mutex> guard(m_Ready);
+            return !Ready.empty();
+        }
+    }
+
+    void Scheduler::WaitForWork(chrono::milliseconds timeout) {
+        unique_lock<mutex> lock(m_Ready);
+        ReadyCV.wait_for(lock, timeout, [this]() { return Woken || !Ready.empty(); });
+        Woken = false;
+    }
+
+    void Scheduler::Wake() {
+        {
+            //Critical Section
+            lock_guard<mutex> guard(m_Ready);
+            Woken = true;
+        }
+        ReadyCV.notify_one();
+    }
+
+    Scheduler::YieldAwaiter Scheduler::Yield() {
+        return YieldAwaiter{this};
+    }
+
+    Scheduler::OffloadAwaiter Scheduler::Offload(function<void()> work) {
+        return OffloadAwaiter{this, move(work)};
+    }
+
+    void Scheduler::RunOnWorker(function<void()> job) {
+        {
+            //Critical Section
+            lock_guard<mutex> guard(m_Jobs);
+            Jobs.push_back(move(job));
+        }
+        JobsCV.notify_one();
+    }
+} // namespace classes::server_side
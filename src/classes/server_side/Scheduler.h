@@ -0,0 +1,86 @@
+#ifndef CHAT2_SCHEDULER_H
+#define CHAT2_SCHEDULER_H
+
+#include <coroutine>
+#include <deque>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "Task.h"
+
+using namespace std;
+
+namespace classes::server_side {
+    /**
+     * Runs Tasks on the dispatcher thread. Suspended coroutines are resumed by RunReady(), which the dispatcher
+     * calls once per loop iteration; blocking work is pushed to a small worker pool with Offload().
+     */
+    class Scheduler {
+    public:
+        struct YieldAwaiter {
+            Scheduler *Owner;
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(coroutine_handle<> awaiting);
+            void await_resume() const noexcept {}
+        };
+
+        struct OffloadAwaiter {
+            Scheduler *Owner;
+            function<void()> Work;
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(coroutine_handle<> awaiting);
+            void await_resume() const noexcept {}
+        };
+
+        explicit Scheduler(unsigned int workerCount = 2);
+        ~Scheduler();
+        Scheduler(const Scheduler &) = delete;
+        Scheduler &operator=(const Scheduler &) = delete;
+
+        /**
+         * Starts the task inline on the calling (dispatcher) thread. The task frees itself once it finishes.
+         */
+        void Spawn(Task task);
+        /**
+         * Queues a suspended coroutine to be resumed by the next RunReady(). Safe to call from any thread.
+         */
+        void Schedule(coroutine_handle<> coroutine);
+        /**
+         * Resumes every coroutine that was ready when called, returns how many were resumed.
+         */
+        size_t RunReady();
+        bool HasReady();
+        /**
+         * Blocks the dispatcher until a coroutine is scheduled, Wake() is called or the timeout passes.
+         */
+        void WaitForWork(chrono::milliseconds timeout);
+        /**
+         * Ends the current (or next) WaitForWork(), used when work arrives that isn't a coroutine.
+         */
+        void Wake();
+
+        YieldAwaiter Yield();
+        OffloadAwaiter Offload(function<void()> work);
+    private:
+        mutex m_Ready;
+        condition_variable ReadyCV;
+        deque<coroutine_handle<>> Ready;
+        bool Woken;
+
+        mutex m_Jobs;
+        condition_variable JobsCV;
+        deque<function<void()>> Jobs;
+        vector<thread> Workers;
+        bool Stopping;
+
+        void RunOnWorker(function<void()> job);
+    };
+} // namespace classes::server_side
+
+#endif //CHAT2_SCHEDULER_H
@@ -6,9 +6,13 @@
 #include <sstream>
 #include <fcntl.h>
 #include <sys/select.h>
+#include <algorithm>
+#include <sys/mman.h>
 
 #include "ClientConnection.h"
 #include "RegisteredClient.h"
+#include "FrameEncoder.h"
+#include "util/Bytes.h"
 
 typedef sockaddr_storage SocketAddressStorage;
 typedef sockaddr SocketAddress;
@@ -29,6 +33,18 @@ namespace classes::server_side {
             shutdown(ServerFD, SHUT_RDWR);
         }
         Running->store(false);
+        {
+            // Taken so the notify cannot fall between the loop's check and its wait
+            lock_guard<mutex> guard(m_SnapshotTimer);
+        }
+        SnapshotCV.notify_all();
+        if (SnapshotThread && SnapshotThread->joinable()) {
+            SnapshotThread->join();
+            delete SnapshotThread;
+        }
+        // A clean shutdown leaves nothing in the WAL to replay at the next start
+        if (Wal.LastLsn() != SnapshotLsn.load())
+            TakeSnapshot();
         if (ListenerThread && ListenerThread->joinable()) {
             ListenerThread->join();
             delete ListenerThread;
@@ -47,8 +63,12 @@ namespace classes::server_side {
 
 
     Server::Server(string &&name) :
-            ServerName(move(name)) {
+            ServerName(move(name)),
+            Presence([this](unsigned long long recipient, const vector<util::FrameRef> &frames) {
+                return DeliverPresence(recipient, frames);
+            }) {
         Setup();
+        Recover();
     }
 
     int make_socket_non_blocking(int sfd) {
@@ -95,8 +115,9 @@ namespace classes::server_side {
                 unique_ptr<ClientConnection> conn = make_unique<ClientConnection>();
                 conn->FileDescriptor = newFD;
                 memcpy(&conn->Address, &addr, sizeof(conn->Address));
-                auto tmpClient = std::make_shared<RegisteredClient>((string) "Guest");
-                tmpClient->LinkClientConnection(move(conn));
+                conn->PeerAddress = s;
+                auto tmpClient = RegisteredClient::Create("Guest");
+                tmpClient->LinkClientConnection(conn);
 
                 auto f = [this](const shared_ptr<RegisteredClient> &client, int fd, shared_ptr<atomic<bool>> stop) -> void {
                     if (make_socket_non_blocking(fd) == -1) {
@@ -115,21 +136,21 @@ namespace classes::server_side {
                     timeout.tv_sec = 5;  // Set timeout to 5 seconds
                     timeout.tv_usec = 0;
 
-                    auto resp = client->GetResponse();
-                    {
-                        lock_guard<mutex> guard(*client->m_AwaitingResponses);
-                        if (!client->PoppedEmptyFlag) {
-                            string sendData = resp.Serialize();
-                            send(fd, sendData.c_str(), sendData.size(), 0);
-                            return;
-                        }
-                        if (resp.IsLast) {
-                            client->Connection->Stop();
-                            client->Connection = nullptr;
-                        }
+                    auto resp = NextOutbound(*client);
+                    if (resp) {
+                        // The frame goes back to the pool once the last queue holding it has sent it
+                        send(fd, resp.Data(), resp.Size(), 0);
+                        return;
                     }
 
-                    int activity = select(fd + 1, &read_fds, nullptr, nullptr, &timeout);
+                    // Nothing to send: wait for inbound data or for a frame to be pushed to the queue
+                    if (!client->Outbound->Park())
+                        return;
+                    int wake = client->Outbound->WakeHandle();
+                    if (wake != -1)
+                        FD_SET(wake, &read_fds);
+
+                    int activity = select(max(fd, wake) + 1, &read_fds, nullptr, nullptr, &timeout);
                     if (activity < 0) {
                         perror("select");
                         close(fd);
@@ -144,6 +165,11 @@ namespace classes::server_side {
                         if (valread < 0) {
                             perror("recv");
                             close(fd);
+                            {
+                                lock_guard<mutex> guard(m_Clients);
+                                RevokeSession(client.get());
+                                MarkConnected(client.get(), false);
+                            }
 
                             stop->store(true);
 
@@ -151,6 +177,11 @@ namespace classes::server_side {
                         } else if (valread == 0) {
                             // Connection closed
                             close(fd);
+                            {
+                                lock_guard<mutex> guard(m_Clients);
+                                RevokeSession(client.get());
+                                MarkConnected(client.get(), false);
+                            }
 
                             stop->store(true);
 
@@ -159,10 +190,19 @@ namespace classes::server_side {
 
                         string data(buffer, valread);
                         auto action = make_shared<ServerAction>(ServerAction::Deserialize(data));
-                        {
-                            lock_guard<mutex> guard(*client->m_AwaitingResponses);
-                            PushAction(client, action);
+                        auto retryAfter = Admit(client, *action);
+                        if (retryAfter > 0) {
+                            // The client doesn't wait for a reply to these, a Busy would pair with its next request
+                            if (action->ActionType == ServerActionType::FetchHistory ||
+                                action->ActionType == ServerActionType::SetTyping)
+                                return;
+                            client->PushResponse(ClientAction(ClientActionType::InformServerBusy,
+                                                              {},
+                                                              to_string(retryAfter) + " Server busy, retry after " +
+                                                              to_string(retryAfter) + "ms"));
+                            return;
                         }
+                        PushAction(client, action);
 
                     }
                 };
@@ -170,6 +210,8 @@ namespace classes::server_side {
                 {
                     lock_guard<mutex> guard(m_Clients);
                     Clients.push_back(tmpClient);
+                    ClientIndex.Insert(tmpClient->ClientID, tmpClient.get());
+                    Table.Add(tmpClient.get(), true);
                 }
 
             }
@@ -178,17 +220,31 @@ namespace classes::server_side {
         ListenerThread->detach();
         EnactRespondThread = new thread([this] { EnactRespond(); });
         EnactRespondThread->detach();
+        SnapshotThread = new thread([this] { SnapshotLoop(); });
     }
 
 
     void Server::Stop() {
         Running->store(false);
+        Tasks.Wake();
+        {
+            lock_guard<mutex> guard(m_SnapshotTimer);
+        }
+        SnapshotCV.notify_all();
     }
 
     void Server::Setup() {
         Running = make_shared<atomic<bool>>();
         EnqueuedActions = {};
+        LatencyTargetMicros = 50000;
+        QueueLatencyMicros.store(0);
+        RejectedCount.store(0);
+        ShedCount.store(0);
+        SessionRng.seed(random_device{}());
+        AnnouncementSeq = 0;
         ListenerThread = nullptr;
+        SnapshotThread = nullptr;
+        SnapshotLsn.store(0);
         Running->store(false);
         ServerFD = -1;
         AddressInfo hints{}, *servInf;
@@ -270,452 +326,1190 @@ namespace classes::server_side {
         {
             //Critical Section
             lock_guard<mutex> guard(m_EnqueuedActions);
-            EnqueuedActions.push(tuple<shared_ptr<RegisteredClient>, shared_ptr<ServerAction>>(client, act));
+            EnqueuedActions.Push(ActionLanes::Entry(client, act));
         }
+        Tasks.Wake();
     }
 
-    tuple<shared_ptr<RegisteredClient>, shared_ptr<ServerAction>> Server::NextAction() {
+    size_t Server::NextActions(vector<ActionLanes::Entry> &out, size_t maxCount) {
+        chrono::microseconds waited{}, maxWaited{};
         {
             //Critical Section
             lock_guard<mutex> guard(m_EnqueuedActions);
-            auto tmp = EnqueuedActions.front();
-            EnqueuedActions.pop();
-            return tmp;
+            ActionLanes::Entry next;
+            while (out.size() < maxCount && EnqueuedActions.Pop(next, waited)) {
+                out.push_back(move(next));
+                maxWaited = max(maxWaited, waited);
+            }
         }
+        if (out.empty()) {
+            // Nothing waited this turn, let the average decay rather than reset so shedding doesn't flap
+            auto prev = QueueLatencyMicros.load();
+            QueueLatencyMicros.store(prev - prev / 8);
+            return 0;
+        }
+        // Smoothed queueing delay, fed back into Admit()
+        auto prev = QueueLatencyMicros.load();
+        QueueLatencyMicros.store(prev - prev / 8 + (unsigned long long) maxWaited.count() / 8);
+        return out.size();
     }
 
-    void Server::EnactRespond() {
-        while (Running->load()) {
-            shared_ptr<ServerAction> currentAct;
-            shared_ptr<RegisteredClient> currentRequester = nullptr;
-
-            if (EnqueuedActions.empty()) {
-                continue; // Skips to the next iteration of the while loop if the queue is empty
-            } else {
-                auto [r, a] = NextAction();
-                currentRequester = r;
-                currentAct = a;
-            }
+    bool Server::PeekRoomID(const ServerAction &act, unsigned long long &rID) {
+        if (act.ActionType != ServerActionType::SendMessage)
+            return false;
+        stringstream ss(act.Data);
+        return (bool) (ss >> rID);
+    }
 
-            if (currentRequester == nullptr) {
+    util::FrameRef Server::NextOutbound(RegisteredClient &client) {
+        auto &window = client.Coalescing;
+        // Once a skip-ahead has caught up, the client hears about the gap before anything newer
+        if (auto gap = GapMarker(client))
+            return gap;
+        auto frame = client.GetResponse();
+        if (!frame) {
+            if (auto gap = GapMarker(client))
+                return gap;
+            window.Idle();
+            return {};
+        }
+        const auto messageKind = static_cast<uint8_t>(ClientActionType::MessageReceived);
+        if (frame.Kind() != messageKind || window.Current().count() == 0) {
+            window.Update(1, client.Outbound->Depth() > 0);
+            return frame;
+        }
+
+        // Pack the messages that show up within the window into a single write
+        vector<util::FrameRef> batch;
+        size_t bytes = FrameEncoder::BatchRecordSize(frame);
+        batch.push_back(move(frame));
+        auto deadline = chrono::steady_clock::now() + window.Current();
+        while (true) {
+            auto next = client.Outbound->PopIf([&bytes, messageKind](const util::FrameRef &queued) {
+                return queued.Kind() == messageKind && bytes + FrameEncoder::BatchRecordSize(queued) <= MaxBatchBytes;
+            });
+            if (next) {
+                bytes += FrameEncoder::BatchRecordSize(next);
+                batch.push_back(move(next));
                 continue;
             }
+            // Either the batch is full or something that must not be packed is next
+            if (client.Outbound->Depth() > 0)
+                break;
+            auto now = chrono::steady_clock::now();
+            if (now >= deadline)
+                break;
+            this_thread::sleep_for(min(chrono::duration_cast<chrono::microseconds>(deadline - now),
+                                       chrono::microseconds(25)));
+        }
+        window.Update(batch.size(), client.Outbound->Depth() > 0);
+        if (batch.size() == 1)
+            return move(batch.front());
+        return FrameEncoder::MessageBatch(batch);
+    }
+
+    util::FrameRef Server::GapMarker(RegisteredClient &client) {
+        auto skipped = client.Outbound->TakeSkipped();
+        if (skipped.empty())
+            return {};
+        vector<util::FrameRef> gaps;
+        for (auto &range: skipped)
+            gaps.push_back(FrameEncoder::MessageGap(range.Room, range.FirstSeq - 1,
+                                                    range.LastSeq - range.FirstSeq + 1));
+        if (gaps.size() == 1)
+            return move(gaps.front());
+        return FrameEncoder::MessageBatch(gaps);
+    }
+
+    string_view Server::MessageBody(const ServerAction &act) {
+        // Same split as `ss >> rID; getline(ss, msg)`, without copying: skip the room id, keep the rest of the line
+        string_view data(act.Data);
+        auto pos = data.find_first_not_of(" \t\n\r\f\v");
+        if (pos != string_view::npos)
+            pos = data.find_first_of(" \t\n\r\f\v", pos);
+        if (pos == string_view::npos)
+            return {};
+        auto body = data.substr(pos);
+        return body.substr(0, body.find('\n'));
+    }
+
+    unsigned long long Server::Admit(const shared_ptr<RegisteredClient> &client, const ServerAction &act) {
+        auto lane = ActionLanes::Classify(act.ActionType);
+        auto latency = QueueLatencyMicros.load();
+        if (lane == ActionLane::Messages && latency > LatencyTargetMicros) {
+            ShedCount++;
+            return latency / 1000 + 1;
+        }
+
+        unsigned long long rID = 0;
+        bool hasRoom = PeekRoomID(act, rID);
+        auto wait = Limiter.Admit(client->ClientID,
+                                  client->Connection ? client->Connection->PeerAddress : "",
+                                  hasRoom, rID);
+        if (wait > 0)
+            RejectedCount++;
+        return wait;
+    }
+
+    unsigned long long Server::GetQueueLatencyMicros() const {
+        return QueueLatencyMicros.load();
+    }
+
+    unsigned long long Server::GetRejectedCount() const {
+        return RejectedCount.load();
+    }
+
+    size_t Server::GetFanoutBacklog() const {
+        return Fanout.Backlog();
+    }
 
+    AnnouncementReport Server::Announce(string_view text) {
+        auto start = chrono::steady_clock::now();
+        auto frame = FrameEncoder::Encode(ClientActionType::Announcement, text);
+        AnnouncementReport report{};
+        vector<OutboundQueue *> targets;
+        {
+            lock_guard<mutex> guard(m_Clients);
+            AnnouncementSeq++;
+            LastAnnouncement = frame;
+            // One pass over the hot table. Connected clients are registered ones, whose queues live as long
+            // as the server, so the pushes below need no lock.
+            targets.reserve(Table.Size());
+            report.Queued = Table.CollectConnected(targets);
             stringstream logSS{};
-            stringstream ss(currentAct->Data);
-            unsigned long long id;
-            string key;
-
-            switch (currentAct->ActionType) {
-                case ServerActionType::SendMessage: {
-                    unsigned long long rID;
-                    string msg;
-                    ss >> id >> key >> rID;
-                    getline(ss,msg);
-                    if (VerifyIdentity(id, key)) {
-                        bool found = false;
-                        ChatroomHost *room = nullptr;
-                        {
-                            lock_guard<mutex> guard(m_Clients);
-                            for (auto &curR: Rooms) {
-                                if (curR.RoomID == rID) {
-                                    room = &curR;
-                                    for (auto &curMem: curR.Members) {
-                                        if (curMem->ClientID == id) {
-                                            found = true;
-                                            break;
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                        if (!room) {
-                            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                        currentRequester->Connection->Address,
-                                                                        "Cannot find requested room."));
-                            continue;
-                        }
-                        if (!found) {
-                            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                        currentRequester->Connection->Address,
-                                                                        "You can't send a message to a chat room you are not a member of."));
-                            continue;
-                        }
-                        {
-                            lock_guard<mutex> guard(m_Clients);
-                            for (auto &curMem: room->Members) {
-                                stringstream msgSS{};
-                                msgSS << id << " " << rID << " " << msg;
-                                curMem->PushResponse(ClientAction(ClientActionType::MessageReceived,
-                                                                  {},
-                                                                  msgSS.str()));
-                            }
-                        }
-                        currentRequester->PushResponse(ClientAction(general::ClientActionType::InformActionSuccess,
-                                                                    {},
-                                                                    "Message sent"));
-                        logSS << "Message sent in room: '"
-                              << room->DisplayName
-                              << "#"
-                              << room->RoomID
-                              << "'. Message content:'"
-                              << msg
-                              << "' Message sender ID: '"
-                              << id
-                              << "'";
-                        ServerLog.emplace_back(logSS.str());
-                        room->PushMessage(id, msg);
-                    } else {
-                        currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                    currentRequester->Connection->Address,
-                                                                    "Invalid credentials, failed to send message."));
-                    }
-                    break;
-                }
-                case ServerActionType::RegisterClient: {
-                    string dispName;
-                    ss >> dispName >> key;
-                    auto newCl = make_shared<RegisteredClient>(dispName);
-                    newCl->LoginKey = key;
-                    {
-                        lock_guard<mutex> guard(m_Clients);
-                        Clients.push_back(move(newCl));
-                        newCl = Clients[Clients.size() - 1];
-
-                        logSS << "Created client: '" << newCl->DisplayName << "#" << newCl->ClientID << "'";
-                        ServerLog.emplace_back(logSS.str());
-                    }
-                    currentRequester->PushResponse(ClientAction(ClientActionType::InformActionSuccess,
-                                                                currentRequester->Connection->Address,
-                                                                to_string(newCl->ClientID)));
-                    break;
-                }
-                case ServerActionType::LoginClient: {
-                    ss >> id >> key;
-                    RegisteredClient *client = nullptr;
-                    {
-                        lock_guard<mutex> guard(m_Clients);
-
-                        for (auto &c: Clients) {
-                            if (c->ClientID == id) {
-                                if (c->LoginKey == key) {
-                                    client = c.get();
-                                    break;
-                                } else {
-                                    currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                                currentRequester->Connection->Address,
-                                                                                "Invalid credentials, Login failed"));
-                                    continue;
-                                }
-                            }
-                        }
+            logSS << "Announcement #" << AnnouncementSeq << ": '" << text << "'";
+            ServerLog.emplace_back(logSS.str());
+        }
 
-                        if (!client) {
-                            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                        currentRequester->Connection->Address,
-                                                                        "Invalid credentials, Login failed"));
-                            continue;
-                        }
+        // Chunks big enough that a thread is worth starting for one
+        const size_t minChunk = 16384;
+        size_t workers = min<size_t>(max(1u, thread::hardware_concurrency()), targets.size() / minChunk + 1);
+        size_t chunk = (targets.size() + workers - 1) / workers;
+        atomic<size_t> delivered = 0;
+        auto pushChunk = [&targets, &frame, &delivered, chunk](size_t index) {
+            size_t begin = index * chunk, end = min(targets.size(), begin + chunk);
+            if (begin >= end)
+                return;
+            // One atomic add on the frame for the whole chunk instead of one per queue
+            frame.Retain(end - begin);
+            size_t accepted = 0;
+            for (size_t i = begin; i < end; i++)
+                accepted += targets[i]->Push(frame.Claim());
+            delivered.fetch_add(accepted, memory_order_relaxed);
+        };
+        vector<thread> helpers;
+        for (size_t i = 1; i < workers; i++)
+            helpers.emplace_back(pushChunk, i);
+        pushChunk(0);
+        for (auto &helper: helpers)
+            helper.join();
+
+        report.Delivered = delivered.load();
+        report.Dropped = targets.size() - report.Delivered;
+        report.Elapsed = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+        return report;
+    }
 
-                        if (currentRequester->IsConnected) {
-                            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                        currentRequester->Connection->Address,
-                                                                        "Nothing to do, you are already logged in"));
-                            continue;
-                        }
-                    }
-                    client->LinkClientConnection(move(currentRequester->Connection));
-                    client->IsConnected = true;
-                    {
-                        lock_guard<mutex> guard(m_Clients);
-                        // Remove Guest Client
-                        auto it = find_if(Clients.begin(), Clients.end(),
-                                          [currentRequester](shared_ptr<RegisteredClient> &c) {
-                                              return c.get() == currentRequester.get();
-                                          });
-
-                        if (it != Clients.end()) {
-                            Clients.erase(it);
-                        }
-                        client->PushResponse(ClientAction(ClientActionType::InformActionSuccess,
-                                                          client->Connection->Address,
-                                                          ServerName + " You were logged in successfully"));
-                        logSS << "Client: '" << client->DisplayName << "#" << client->ClientID << "' has logged in";
-                        ServerLog.emplace_back(logSS.str());
-                    }
+    size_t Server::GetPresencePending() const {
+        return Presence.Pending();
+    }
 
-                    break;
+    unsigned long long Server::GetPresenceCoalesced() const {
+        return Presence.Coalesced();
+    }
+
+    WalStats Server::GetWalStats() const {
+        return {Wal.Mode(), Wal.LastLsn(), Wal.DurableLsn(), Wal.Syncs()};
+    }
+
+    void Server::SetDurability(Durability mode) {
+        Wal.SetMode(mode);
+    }
+
+    SnapshotReport Server::TakeSnapshot() {
+        auto started = chrono::steady_clock::now();
+        lock_guard<mutex> snapshotGuard(m_Snapshot);
+        SnapshotWriter writer;
+        SnapshotInfo info{};
+        SnapshotReport report{};
+        vector<pair<shared_ptr<HistoryStore::Mapping>, size_t>> unsynced;
+        {
+            //Critical Section
+            lock_guard<mutex> guard(m_Clients);
+            info = {Wal.LastLsn(), RegisteredClient::NextID(), ChatroomHost::NextID()};
+            for (auto &client: Clients) {
+                // Guests never registered and are not kept
+                if (client->Slot == NoSlot || Table.Guest(client->Slot))
+                    continue;
+                auto name = client->DisplayName.Str();
+                writer.AddClient({client->ClientID, name, client->LoginKey});
+                report.Clients++;
+            }
+            Rooms.ForEach([&](util::SlotHandle, ChatroomHost &room) {
+                auto name = room.DisplayName.Str();
+                RoomImage image{room.RoomID, room.Admin->ClientID, room.Messages.NextSeq(), name, {}};
+                image.Members.reserve(room.Members.Size());
+                for (auto slot: room.Members)
+                    image.Members.push_back(Table.Id(slot));
+                writer.AddRoom(image);
+                room.History.CollectUnsynced(unsynced);
+                report.Rooms++;
+            });
+            // Everything after info.WalLsn goes to a fresh file, the rest can go once the snapshot is down
+            Wal.Rotate(info.WalLsn);
+        }
+
+        // Messages up to info.WalLsn now live only in the history segments. The collected mappings are held, so a
+        // room dropped or rolled over since then is still mapped here
+        for (auto &[map, size]: unsynced)
+            if (size > 0 && msync(map->Base, size, MS_SYNC) == -1)
+                perror("history msync");
+        unsynced.clear();
+        report.Lsn = info.WalLsn;
+        report.Bytes = writer.Commit(SnapshotPath, info);
+        if (report.Bytes > 0) {
+            unlink(Wal.RetiredPath().c_str());
+            SnapshotLsn.store(info.WalLsn);
+        }
+        report.Elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started);
+        return report;
+    }
+
+    unsigned long long Server::GetSnapshotLsn() const {
+        return SnapshotLsn.load();
+    }
+
+    void Server::SnapshotLoop() {
+        unique_lock<mutex> lock(m_SnapshotTimer);
+        while (Running->load()) {
+            if (SnapshotCV.wait_for(lock, SnapshotInterval, [this] { return !Running->load(); }))
+                break;
+            if (Wal.LastLsn() == SnapshotLsn.load())
+                continue;
+            lock.unlock();
+            TakeSnapshot();
+            lock.lock();
+        }
+    }
+
+    void Server::Recover() {
+        auto started = chrono::steady_clock::now();
+        lock_guard<mutex> guard(m_Clients);
+        unsigned long long lsn = 0;
+        {
+            SnapshotReader snapshot(SnapshotPath);
+            if (snapshot.Valid() && RestoreSnapshot(snapshot))
+                lsn = snapshot.Info().WalLsn;
+            else if (access(SnapshotPath, F_OK) == 0)
+                cerr << "Snapshot '" << SnapshotPath << "' is damaged, recovering from the WAL alone" << endl;
+        }
+
+        // A rotation the last snapshot did not finish leaves the older records in the retired file
+        size_t replayed = 0;
+        auto apply = [this, &replayed](const WalRecord &record) {
+            ApplyWalRecord(record);
+            replayed++;
+        };
+        auto last = max(lsn, WriteAheadLog::Replay(Wal.RetiredPath(), lsn, apply));
+        last = max(last, WriteAheadLog::Replay(Wal.Path(), lsn, apply));
+        Wal.ResumeAfter(last);
+        SnapshotLsn.store(lsn);
+
+        if (!Clients.empty() || Rooms.Size() > 0) {
+            stringstream logSS{};
+            logSS << "Recovered " << Clients.size() << " clients and " << Rooms.Size() << " rooms from snapshot LSN "
+                  << lsn << " and " << replayed << " WAL records in "
+                  << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count()
+                  << " ms";
+            ServerLog.emplace_back(logSS.str());
+        }
+    }
+
+    bool Server::RestoreSnapshot(const SnapshotReader &snapshot) {
+        auto &chunks = snapshot.Chunks();
+        // Where each client chunk's accounts start in the restored list
+        vector<size_t> firstClient(chunks.size(), 0);
+        size_t clientCount = 0;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            firstClient[i] = clientCount;
+            if (chunks[i].Section == SnapshotSection::Clients)
+                clientCount += chunks[i].Count;
+        }
+
+        // Decoding, checksums and creating the accounts dominate, and touch no shared state
+        vector<shared_ptr<RegisteredClient>> restored(clientCount);
+        vector<vector<RoomImage>> rooms(chunks.size());
+        atomic<size_t> next = 0;
+        atomic<bool> damaged = false;
+        auto decode = [&]() {
+            vector<ClientImage> images;
+            for (auto i = next++; i < chunks.size() && !damaged.load(); i = next++) {
+                if (chunks[i].Section == SnapshotSection::Rooms) {
+                    if (!snapshot.DecodeRooms(i, rooms[i]))
+                        damaged.store(true);
+                    continue;
                 }
-                case ServerActionType::LogoutClient: {
-                    ss >> id >> key;
-                    {
-                        lock_guard<mutex> guard(m_Clients);
-                        RegisteredClient *client = nullptr;
-
-                        for (auto &c: Clients) {
-                            if (c->ClientID == id) {
-                                if (c->LoginKey == key) {
-                                    client = c.get();
-                                    break;
-                                } else {
-                                    currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                                currentRequester->Connection->Address,
-                                                                                "Invalid credentials, Logout failed"));
-                                    continue;
-                                }
-                            }
-                        }
-                        client->IsConnected = false;
-                        client->PushResponse(ClientAction(ClientActionType::InformActionSuccess,
-                                                          client->Connection->Address,
-                                                          "You were successfully logged out",
-                                                          true));
-                        logSS << "Client: '" << client->DisplayName << "#" << client->ClientID << "' has logged out";
-                        ServerLog.emplace_back(logSS.str());
-                    }
-                    break;
+                images.clear();
+                if (!snapshot.DecodeClients(i, images)) {
+                    damaged.store(true);
+                    continue;
                 }
-                case ServerActionType::CreateChatroom: {
-                    string roomName;
-                    ss >> id >> key >> roomName;
-                    if (VerifyIdentity(id, key)) {
-                        RegisteredClient *admin = nullptr;
-                        {
-                            lock_guard<mutex> guard(m_Clients);
-                            for (auto &curCl: Clients)
-                                if (curCl->ClientID == id)
-                                    admin = curCl.get();
-                        }
-                        ChatroomHost newCR = ChatroomHost(roomName, admin);
-                        Rooms.push_back(newCR);
-                        {
-                            lock_guard<mutex> guard(m_Clients);
-                            logSS << "Client: '"
-                                  << admin->DisplayName
-                                  << "#"
-                                  << admin->ClientID
-                                  << "' Created the new chatroom: '"
-                                  << newCR.DisplayName
-                                  << "#"
-                                  << newCR.RoomID
-                                  << "'";
-                            ServerLog.emplace_back(logSS.str());
-                        }
+                for (size_t j = 0; j < images.size(); j++)
+                    restored[firstClient[i] + j] = RegisteredClient::Restore(images[j].ClientID,
+                                                                             string(images[j].DisplayName),
+                                                                             string(images[j].LoginKey));
+            }
+        };
+        size_t workers = min<size_t>(max(1u, thread::hardware_concurrency()), chunks.size());
+        vector<thread> pool;
+        for (size_t i = 1; i < workers; i++)
+            pool.emplace_back(decode);
+        decode();
+        for (auto &worker: pool)
+            worker.join();
+        if (damaged.load())
+            return false;
 
-                        currentRequester->PushResponse(ClientAction(ClientActionType::InformActionSuccess,
-                                                                    currentRequester->Connection->Address,
-                                                                    to_string(newCR.RoomID) +
-                                                                    " Chat room was created$"));
-                        currentRequester->PushResponse(ClientAction(ClientActionType::JoinedChatroom,
-                                                                    currentRequester->Connection->Address,
-                                                                    to_string(newCR.RoomID) + " " + newCR.DisplayName));
+        Clients.reserve(Clients.size() + clientCount);
+        ClientIndex.Reserve(ClientIndex.Size() + clientCount);
+        Table.Reserve(clientCount);
+        for (auto &client: restored)
+            RestoreClient(move(client));
+        for (auto &chunk: rooms) {
+            for (auto &image: chunk) {
+                auto room = RestoreRoom(image.RoomID, image.AdminID, image.DisplayName);
+                if (!room)
+                    continue;
+                room->Messages.Resume(image.NextSeq);
+                for (auto memberID: image.Members) {
+                    auto member = FindClient(memberID);
+                    if (member && room->Members.Insert(memberID, member->Slot))
+                        member->JoinedRooms.insert(image.RoomID);
+                }
+            }
+        }
+        auto &info = snapshot.Info();
+        RegisteredClient::ResumeIDs(info.NextClientID);
+        ChatroomHost::ResumeIDs(info.NextRoomID);
+        return true;
+    }
+
+    void Server::ApplyWalRecord(const WalRecord &record) {
+        util::ByteReader reader(record.Payload);
+        unsigned long long id, other;
+        string_view text, key;
+        switch (record.Type) {
+            case WalRecordType::RegisterClient:
+                if (reader.U64(id) && reader.Text(text) && reader.Text(key) && !FindClient(id)) {
+                    RestoreClient(RegisteredClient::Restore(id, string(text), string(key)));
+                    RegisteredClient::ResumeIDs(id + 1);
+                }
+                break;
+            case WalRecordType::CreateRoom:
+                if (reader.U64(id) && reader.U64(other) && reader.Text(text))
+                    RestoreRoom(id, other, text);
+                break;
+            case WalRecordType::RemoveRoom:
+                if (reader.U64(id)) {
+                    auto room = FindRoom(id);
+                    if (!room)
+                        break;
+                    for (auto slot: room->Members)
+                        Table.Record(slot)->JoinedRooms.erase(id);
+                    room->History.Drop();
+                    Rooms.Erase(*RoomIndex.Find(id));
+                    RoomIndex.Erase(id);
+                }
+                break;
+            case WalRecordType::AddMember:
+            case WalRecordType::RemoveMember:
+                if (reader.U64(id) && reader.U64(other)) {
+                    auto room = FindRoom(id);
+                    auto member = FindClient(other);
+                    if (!room || !member)
+                        break;
+                    if (record.Type == WalRecordType::AddMember) {
+                        room->Members.Insert(other, member->Slot);
+                        member->JoinedRooms.insert(id);
                     } else {
-                        currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                    currentRequester->Connection->Address,
-                                                                    "Invalid credentials"));
+                        room->Members.Erase(other);
+                        member->JoinedRooms.erase(id);
                     }
-                    break;
                 }
-                case ServerActionType::RemoveChatroom: {
-                    unsigned long long rID;
-                    ChatroomHost *room = nullptr;
-                    ss >> id >> key >> rID;
-                    if (VerifyIdentity(id, key)) {
-                        for (auto &curR: Rooms) {
-                            if (curR.RoomID == rID) {
-                                room = &curR;
-                                break;
-                            }
-                        }
-                        if (!room) {
-                            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                        currentRequester->Connection->Address,
-                                                                        "Failed to find requested room"));
-                            continue;
-                        }
-                        if (room->Admin->ClientID != id) {
-                            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                        currentRequester->Connection->Address,
-                                                                        "You must be the room's admin in order to delete it"));
-                            continue;
-                        }
-                        auto it = find_if(Rooms.begin(), Rooms.end(),
-                                          [rID](const ChatroomHost &cr) -> bool {
-                                              return cr.RoomID == rID;
-                                          });
-                        if (it != Rooms.end()) {
-                            for (auto &curMem: room->Members)
-                                curMem->PushResponse(ClientAction(ClientActionType::LeftChatroom,
-                                                                  curMem->Connection->Address,
-                                                                  to_string(room->RoomID) +
-                                                                  " This room was deleted by the admin."));
-                            Rooms.erase(it);
-                        }
-                    }
+                break;
+            case WalRecordType::Message: {
+                unsigned long long seq;
+                if (!reader.U64(id) || !reader.U64(seq) || !reader.U64(other) || !reader.Text(text))
+                    break;
+                auto room = FindRoom(id);
+                // Already in the history store
+                if (!room || seq < room->Messages.NextSeq())
                     break;
+                room->Messages.Resume(seq);
+                room->PushMessage(other, text);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    void Server::RestoreClient(shared_ptr<RegisteredClient> client) {
+        ClientIndex.Insert(client->ClientID, client.get());
+        Table.Add(client.get());
+        Clients.push_back(move(client));
+    }
+
+    ChatroomHost *Server::RestoreRoom(unsigned long long rID, unsigned long long adminID, string_view name) {
+        auto admin = FindClient(adminID);
+        if (FindRoom(rID) || !admin)
+            return nullptr;
+        auto handle = Rooms.Emplace(rID, string(name), admin);
+        auto room = Rooms.Get(handle);
+        RoomIndex.Insert(rID, handle);
+        admin->JoinedRooms.insert(rID);
+        room->History.Load();
+        room->Messages.Resume(room->History.NextSeq());
+        return room;
+    }
+
+    unsigned long long Server::GetShedCount() const {
+        return ShedCount.load();
+    }
+
+    LaneMetrics Server::GetLaneMetrics(ActionLane lane) {
+        {
+            //Critical Section
+            lock_guard<mutex> guard(m_EnqueuedActions);
+            return EnqueuedActions.Metrics(lane);
+        }
+    }
+
+    void Server::EnactRespond() {
+        vector<ActionLanes::Entry> batch;
+        map<unsigned long long, vector<ActionLanes::Entry>> roomGroups;
+        while (Running->load()) {
+            Tasks.RunReady();
+
+            batch.clear();
+            auto drained = NextActions(batch, Batching.Current());
+            Batching.Update(drained);
+            if (drained == 0) {
+                // Every lane is empty, sleep until an action or a resumed coroutine arrives. The timeout only
+                // bounds how long Stop() takes to be noticed.
+                Tasks.WaitForWork(chrono::milliseconds(100));
+                continue;
+            }
+
+            // Lanes already yield control and membership work ahead of messages; keep that order and run the
+            // messages afterwards, grouped so each room is resolved once per batch.
+            roomGroups.clear();
+            for (auto &entry: batch) {
+                auto &[currentRequester, currentAct] = entry;
+                if (currentRequester == nullptr || currentAct == nullptr)
+                    continue;
+                unsigned long long rID;
+                if (PeekRoomID(*currentAct, rID))
+                    roomGroups[rID].push_back(move(entry));
+                else
+                    Tasks.Spawn(Dispatch(currentRequester, currentAct));
+            }
+            for (auto &[rID, group]: roomGroups)
+                Tasks.Spawn(HandleSendMessages(rID, move(group)));
+        }
+    }
+
+    Task Server::Dispatch(shared_ptr<RegisteredClient> requester, shared_ptr<ServerAction> act) {
+        switch (act->ActionType) {
+            case ServerActionType::SendMessage: {
+                unsigned long long rID = 0;
+                PeekRoomID(*act, rID);
+                return HandleSendMessages(rID, {ActionLanes::Entry(move(requester), move(act))});
+            }
+            case ServerActionType::RegisterClient:
+                return HandleRegisterClient(move(requester), move(act));
+            case ServerActionType::LoginClient:
+                return HandleLoginClient(move(requester), move(act));
+            case ServerActionType::LogoutClient:
+                return HandleLogoutClient(move(requester), move(act));
+            case ServerActionType::CreateChatroom:
+                return HandleCreateChatroom(move(requester), move(act));
+            case ServerActionType::RemoveChatroom:
+                return HandleRemoveChatroom(move(requester), move(act));
+            case ServerActionType::AddChatRoomMember:
+                return HandleAddChatRoomMember(move(requester), move(act));
+            case ServerActionType::RemoveChatroomMember:
+                return HandleRemoveChatroomMember(move(requester), move(act));
+            case ServerActionType::FetchHistory:
+                return HandleFetchHistory(move(requester), move(act));
+            case ServerActionType::SetTyping:
+                return HandleSetTyping(move(requester), move(act));
+        }
+        return {};
+    }
+
+    Task Server::HandleSendMessages(unsigned long long rID, vector<ActionLanes::Entry> batch) {
+        struct PendingMessage {
+            shared_ptr<RegisteredClient> Requester;
+            unsigned long long SenderID;
+            util::FrameRef Content;
+        };
+        vector<PendingMessage> verified;
+        verified.reserve(batch.size());
+        for (auto &[currentRequester, currentAct]: batch) {
+            if (!VerifySession(currentRequester)) {
+                currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                            {},
+                                                            "Not logged in, failed to send message."));
+                continue;
+            }
+            verified.push_back({currentRequester, currentRequester->ClientID,
+                                util::FramePool::FromString(MessageBody(*currentAct))});
+        }
+        if (verified.empty())
+            co_return;
+        // In per-message mode the acks wait for the batch's records to be synced
+        bool awaitDurable = Wal.Mode() == Durability::PerMessage;
+        vector<shared_ptr<RegisteredClient>> unacked;
+        unsigned long long lastLsn = 0;
+
+        // Resolve the room once for the whole batch
+        ChatroomHost *room = nullptr;
+        {
+            lock_guard<mutex> guard(m_Clients);
+            room = FindRoom(rID);
+        }
+        if (!room) {
+            for (auto &pending: verified)
+                pending.Requester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                             pending.Requester->Connection->Address,
+                                                             "Cannot find requested room."));
+            co_return;
+        }
+
+        {
+            lock_guard<mutex> guard(m_Clients);
+            for (auto &pending: verified) {
+                if (!room->Members.Contains(pending.SenderID)) {
+                    pending.Requester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                                 pending.Requester->Connection->Address,
+                                                                 "You can't send a message to a chat room you are not a member of."));
+                    continue;
                 }
-                case ServerActionType::AddChatRoomMember: {
-                    unsigned long long rID, newMemberID;
-                    ss >> id >> key >> rID >> newMemberID;
-                    if (!VerifyIdentity(id, key)) {
-                        currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                    currentRequester->Connection->Address,
-                                                                    "Invalid credentials"));
-                        continue;
-                    }
+                // Committed once it is in the room's log and the WAL; unless the ack waits for the sync, the
+                // sender is acked before any member is reached
+                auto seq = room->PushMessage(pending.SenderID, pending.Content.View());
+                lastLsn = Wal.AppendMessage(rID, seq, pending.SenderID, pending.Content.View());
+                if (awaitDurable)
+                    unacked.push_back(pending.Requester);
+                else
+                    pending.Requester->PushResponse(ClientAction(general::ClientActionType::InformActionSuccess,
+                                                                 {},
+                                                                 "Message sent"));
+                // Encode once, every member's queue shares the same frame
+                BroadcastFrame(*room, FrameEncoder::MessageReceived(pending.SenderID, rID, seq,
+                                                                  pending.Content.View()));
+                stringstream logSS{};
+                logSS << "Message sent in room: '"
+                      << room->DisplayName
+                      << "#"
+                      << room->RoomID
+                      << "'. Message content:'"
+                      << pending.Content.View()
+                      << "' Message sender ID: '"
+                      << pending.SenderID
+                      << "'";
+                ServerLog.emplace_back(logSS.str());
+            }
+        }
+        if (unacked.empty())
+            co_return;
+        // One sync covers the whole batch, the dispatcher keeps running meanwhile
+        co_await Wal.Durable(lastLsn, Tasks);
+        for (auto &requester: unacked)
+            requester->PushResponse(ClientAction(general::ClientActionType::InformActionSuccess,
+                                                 {},
+                                                 "Message sent"));
+    }
 
-                    ChatroomHost *room = nullptr;
-                    RegisteredClient *newMember = nullptr;
-                    {
-                        lock_guard<mutex> guard(m_Clients);
-                        for (auto &curR: Rooms) {
-                            if (curR.RoomID == rID) {
-                                room = &curR;
-                                break;
-                            }
-                        }
-                        for (auto &curCl: Clients) {
-                            if (curCl->ClientID == newMemberID) {
-                                newMember = curCl.get();
-                                break;
-                            }
-                        }
-                    }
+    Task Server::HandleFetchHistory(shared_ptr<RegisteredClient> currentRequester, shared_ptr<ServerAction> currentAct) {
+        stringstream ss(currentAct->Data);
+        unsigned long long rID = 0, fromSeq = 0, count = 0;
+        ss >> rID >> fromSeq >> count;
+        // Fire and forget like SetTyping: the client sends it without waiting, so a failure reply would be taken
+        // as the answer to its next request
+        if (!VerifySession(currentRequester))
+            co_return;
 
-                    if (!room) {
-                        currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                    currentRequester->Connection->Address,
-                                                                    "Chatroom not found"));
-                        continue;
-                    }
+        vector<util::FrameRef> frames;
+        {
+            lock_guard<mutex> guard(m_Clients);
+            auto room = FindRoom(rID);
+            if (!room || !room->Members.Contains(currentRequester->ClientID))
+                co_return;
+            count = min(count, (unsigned long long) MaxHistoryFetch);
+            auto first = max(fromSeq, room->FirstSeq());
+            vector<LoggedMessage> messages;
+            if (first - fromSeq < count)
+                room->ReadMessages(first, count - (first - fromSeq), messages);
+            for (auto &msg: messages)
+                frames.push_back(FrameEncoder::MessageReceived(msg.SenderID, rID, msg.Seq, msg.Content));
+        }
 
-                    if (room->Admin->ClientID != id) {
-                        currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                    currentRequester->Connection->Address,
-                                                                    "Only the admin can add members"));
-                        continue;
-                    }
+        // Always wrapped in MessageBatch frames: those carry no room tag, so a lagging queue never skips them.
+        // Nothing left in retention gives an empty batch.
+        vector<util::FrameRef> batch;
+        size_t bytes = 0;
+        for (auto &frame: frames) {
+            auto size = FrameEncoder::BatchRecordSize(frame);
+            if (!batch.empty() && bytes + size > MaxBatchBytes) {
+                currentRequester->PushFrame(FrameEncoder::MessageBatch(batch));
+                batch.clear();
+                bytes = 0;
+            }
+            bytes += size;
+            batch.push_back(move(frame));
+        }
+        if (!batch.empty() || frames.empty())
+            currentRequester->PushFrame(FrameEncoder::MessageBatch(batch));
+    }
 
-                    if (!newMember) {
-                        currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                    currentRequester->Connection->Address,
-                                                                    "New member not found"));
-                        continue;
-                    }
+    Task Server::HandleSetTyping(shared_ptr<RegisteredClient> currentRequester, shared_ptr<ServerAction> currentAct) {
+        stringstream ss(currentAct->Data);
+        unsigned long long rID = 0;
+        int typing = 0;
+        ss >> rID >> typing;
+        // Fire and forget: no reply, so an indicator never takes the place of a pending request's response
+        if (!VerifySession(currentRequester))
+            co_return;
+        vector<unsigned long long> recipients;
+        {
+            lock_guard<mutex> guard(m_Clients);
+            auto room = FindRoom(rID);
+            if (!room || !room->Members.Contains(currentRequester->ClientID))
+                co_return;
+            for (auto slot: room->Members)
+                if (Table.Id(slot) != currentRequester->ClientID && Table.Connected(slot))
+                    recipients.push_back(Table.Id(slot));
+        }
+        Presence.Publish(recipients, {currentRequester->ClientID, rID,
+                                      typing ? PresenceState::Typing : PresenceState::Idle});
+    }
+
+    Task Server::HandleRegisterClient(shared_ptr<RegisteredClient> currentRequester, shared_ptr<ServerAction> currentAct) {
+        stringstream logSS{};
+        stringstream ss(currentAct->Data);
+        string key;
+
+        string dispName;
+        ss >> dispName >> key;
+        auto newCl = RegisteredClient::Create(dispName);
+        newCl->LoginKey = key;
+        {
+            lock_guard<mutex> guard(m_Clients);
+            Clients.push_back(move(newCl));
+            newCl = Clients[Clients.size() - 1];
+            ClientIndex.Insert(newCl->ClientID, newCl.get());
+            Table.Add(newCl.get());
+            // Announcements made before the account existed are not replayed
+            newCl->SeenAnnouncement = AnnouncementSeq;
+            Wal.AppendRegisterClient(newCl->ClientID, newCl->DisplayName.Str(), newCl->LoginKey);
+
+            logSS << "Created client: '" << newCl->DisplayName << "#" << newCl->ClientID << "'";
+            ServerLog.emplace_back(logSS.str());
+        }
+        currentRequester->PushResponse(ClientAction(ClientActionType::InformActionSuccess,
+                                                    currentRequester->Connection->Address,
+                                                    to_string(newCl->ClientID)));
+        co_return;
+    }
+
+    Task Server::HandleLoginClient(shared_ptr<RegisteredClient> currentRequester, shared_ptr<ServerAction> currentAct) {
+        stringstream logSS{};
+        stringstream ss(currentAct->Data);
+        unsigned long long id;
+        string key;
+
+        ss >> id >> key;
+        RegisteredClient *client = nullptr;
+        {
+            lock_guard<mutex> guard(m_Clients);
+
+            client = FindClient(id);
+            if (!client || client->LoginKey != key) {
+                currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                            currentRequester->Connection->Address,
+                                                            "Invalid credentials, Login failed"));
+                co_return;
+            }
+
+            if (IsOnline(currentRequester.get())) {
+                currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                            currentRequester->Connection->Address,
+                                                            "Nothing to do, you are already logged in"));
+                co_return;
+            }
+            // The account's connection stays where it is, its thread is still serving it
+            if (IsOnline(client)) {
+                currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                            currentRequester->Connection->Address,
+                                                            "This account is already logged in elsewhere"));
+                co_return;
+            }
+        }
+        client->LinkClientConnection(currentRequester->Connection);
+        {
+            lock_guard<mutex> guard(m_Clients);
+            MarkConnected(client, true);
+            IssueSession(client);
+            // Remove Guest Client. Guests are appended on accept and log in shortly after, so search from the back.
+            auto it = find_if(Clients.rbegin(), Clients.rend(),
+                              [currentRequester](shared_ptr<RegisteredClient> &c) {
+                                  return c.get() == currentRequester.get();
+                              });
+
+            if (it != Clients.rend()) {
+                ClientIndex.Erase((*it)->ClientID);
+                Table.Remove((*it)->Slot);
+                Clients.erase(next(it).base());
+            }
+            client->PushResponse(ClientAction(ClientActionType::InformActionSuccess,
+                                              client->Connection->Address,
+                                              ServerName + " You were logged in successfully"));
+            // Bring the client's view of its rooms up to date, proportional to its own rooms only
+            for (auto rID: client->JoinedRooms) {
+                auto room = FindRoom(rID);
+                if (room)
+                    client->PushResponse(ClientAction(ClientActionType::JoinedChatroom,
+                                                      {},
+                                                      to_string(room->RoomID) + " " + room->DisplayName.Str()));
+            }
+            PushCatchUp(*client);
+            if (LastAnnouncement && client->SeenAnnouncement < AnnouncementSeq)
+                client->PushFrame(LastAnnouncement);
+            client->SeenAnnouncement = AnnouncementSeq;
+            logSS << "Client: '" << client->DisplayName << "#" << client->ClientID << "' has logged in";
+            ServerLog.emplace_back(logSS.str());
+        }
+
+    }
 
-                    room->Members.push_back(newMember);
+    Task Server::HandleLogoutClient(shared_ptr<RegisteredClient> currentRequester,
+                                    [[maybe_unused]] shared_ptr<ServerAction> currentAct) {
+        stringstream logSS{};
+        if (!VerifySession(currentRequester)) {
+            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                        {},
+                                                        "Not logged in, Logout failed"));
+            co_return;
+        }
+        {
+            lock_guard<mutex> guard(m_Clients);
+            RegisteredClient *client = currentRequester.get();
+            RevokeSession(client);
+            MarkConnected(client, false);
+            client->PushResponse(ClientAction(ClientActionType::InformActionSuccess,
+                                              client->Connection->Address,
+                                              "You were successfully logged out",
+                                              true));
+            logSS << "Client: '" << client->DisplayName << "#" << client->ClientID << "' has logged out";
+            ServerLog.emplace_back(logSS.str());
+        }
+    }
+
+    Task Server::HandleCreateChatroom(shared_ptr<RegisteredClient> currentRequester, shared_ptr<ServerAction> currentAct) {
+        stringstream logSS{};
+        stringstream ss(currentAct->Data);
+        string roomName;
+        ss >> roomName;
+        if (VerifySession(currentRequester)) {
+            RegisteredClient *admin = currentRequester.get();
+            ChatroomHost *newCR;
+            {
+                // Under the lock so a snapshot sees the room together with its WAL record
+                lock_guard<mutex> guard(m_Clients);
+                auto handle = Rooms.Emplace(roomName, admin);
+                newCR = Rooms.Get(handle);
+                RoomIndex.Insert(newCR->RoomID, handle);
+                // Room IDs start over if the snapshot and WAL are lost, files left by an earlier room with this ID
+                // are not ours
+                newCR->History.Drop();
+                admin->JoinedRooms.insert(newCR->RoomID);
+                Wal.AppendCreateRoom(newCR->RoomID, admin->ClientID, newCR->DisplayName.Str());
+                logSS << "Client: '"
+                      << admin->DisplayName
+                      << "#"
+                      << admin->ClientID
+                      << "' Created the new chatroom: '"
+                      << newCR->DisplayName
+                      << "#"
+                      << newCR->RoomID
+                      << "'";
+                ServerLog.emplace_back(logSS.str());
+            }
+
+            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionSuccess,
+                                                        currentRequester->Connection->Address,
+                                                        to_string(newCR->RoomID) +
+                                                        " Chat room was created$"));
+            currentRequester->PushResponse(ClientAction(ClientActionType::JoinedChatroom,
+                                                        currentRequester->Connection->Address,
+                                                        to_string(newCR->RoomID) + " " + newCR->DisplayName.Str()));
+        } else {
+            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                        currentRequester->Connection->Address,
+                                                        "Invalid credentials"));
+        }
+        co_return;
+    }
+
+    Task Server::HandleRemoveChatroom(shared_ptr<RegisteredClient> currentRequester, shared_ptr<ServerAction> currentAct) {
+        stringstream logSS{};
+        stringstream ss(currentAct->Data);
+        unsigned long long id = currentRequester->ClientID;
+
+        unsigned long long rID;
+        ss >> rID;
+        if (VerifySession(currentRequester)) {
+            const char *failure = nullptr;
+            {
+                //Critical Section: the room must not change hands or disappear between the admin check and the erase
+                lock_guard<mutex> guard(m_Clients);
+                ChatroomHost *room = FindRoom(rID);
+                if (!room)
+                    failure = "Failed to find requested room";
+                else if (room->Admin->ClientID != id)
+                    failure = "You must be the room's admin in order to delete it";
+                else {
+                    for (auto slot: room->Members)
+                        Table.Record(slot)->JoinedRooms.erase(rID);
+                    BroadcastFrame(*room, FrameEncoder::Encode(ClientActionType::LeftChatroom,
+                                                               to_string(room->RoomID) +
+                                                               " This room was deleted by the admin."));
+                    Wal.AppendRemoveRoom(rID);
+                    room->History.Drop();
+                    Rooms.Erase(*RoomIndex.Find(rID));
+                    RoomIndex.Erase(rID);
+                }
+            }
+            if (failure)
+                currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                            currentRequester->Connection->Address,
+                                                            failure));
+        }
+        co_return;
+    }
+
+    Task Server::HandleAddChatRoomMember(shared_ptr<RegisteredClient> currentRequester, shared_ptr<ServerAction> currentAct) {
+        stringstream logSS{};
+        stringstream ss(currentAct->Data);
+        unsigned long long id = currentRequester->ClientID;
+
+        unsigned long long rID, newMemberID;
+        ss >> rID >> newMemberID;
+        if (!VerifySession(currentRequester)) {
+            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                        currentRequester->Connection->Address,
+                                                        "Invalid credentials"));
+            co_return;
+        }
+
+        ChatroomHost *room = nullptr;
+        RegisteredClient *newMember = nullptr;
+        {
+            lock_guard<mutex> guard(m_Clients);
+            room = FindRoom(rID);
+            newMember = FindClient(newMemberID);
+        }
+
+        if (!room) {
+            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                        currentRequester->Connection->Address,
+                                                        "Chatroom not found"));
+            co_return;
+        }
+
+        if (room->Admin->ClientID != id) {
+            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                        currentRequester->Connection->Address,
+                                                        "Only the admin can add members"));
+            co_return;
+        }
+
+        if (!newMember) {
+            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                        currentRequester->Connection->Address,
+                                                        "New member not found"));
+            co_return;
+        }
+
+        bool added;
+        {
+            lock_guard<mutex> guard(m_Clients);
+            added = room->Members.Insert(newMemberID, newMember->Slot);
+            if (added) {
+                Wal.AppendMembership(WalRecordType::AddMember, rID, newMemberID);
+                room->Audience.reset();
+                newMember->JoinedRooms.insert(rID);
+                // An offline member hears about the room, and what was said since, when it logs in
+                if (IsOnline(newMember))
                     newMember->PushResponse(ClientAction(ClientActionType::JoinedChatroom,
                                                          {},
-                                                         to_string(room->RoomID) + " " + room->DisplayName));
-                    stringstream joinMSG;
-                    currentRequester->PushResponse(ClientAction(general::ClientActionType::InformActionSuccess,
-                                                                {},
-                                                                ""));
-                    logSS << "Client: '"
-                          << newMember->DisplayName
-                          << "#"
-                          << newMember->ClientID
-                          << "' was added to chatroom: '"
-                          << room->DisplayName
-                          << "#"
-                          << room->RoomID
-                          << "'";
-                    ServerLog.emplace_back(logSS.str());
-                    break;
-                }
-                case ServerActionType::RemoveChatroomMember: {
-                    unsigned long long rID, memberID;
-                    ss >> id >> key >> rID >> memberID;
-                    if (!VerifyIdentity(id, key)) {
-                        currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                    currentRequester->Connection->Address,
-                                                                    "Invalid credentials"));
-                        continue;
-                    }
+                                                         to_string(room->RoomID) + " " + room->DisplayName.Str()));
+                else
+                    newMember->MissedFrom.try_emplace(rID, room->Messages.NextSeq());
+            }
+        }
+        if (!added) {
+            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                        currentRequester->Connection->Address,
+                                                        "Client is already a member of this chatroom"));
+            co_return;
+        }
 
-                    ChatroomHost *room = nullptr;
-                    RegisteredClient *member = nullptr;
-                    {
-                        lock_guard<mutex> guard(m_Clients);
-                        for (auto &curR: Rooms) {
-                            if (curR.RoomID == rID) {
-                                room = &curR;
-                                break;
-                            }
-                        }
-                        for (auto &curCl: Clients) {
-                            if (curCl->ClientID == memberID) {
-                                member = curCl.get();
-                                break;
-                            }
-                        }
-                    }
+        stringstream joinMSG;
+        currentRequester->PushResponse(ClientAction(general::ClientActionType::InformActionSuccess,
+                                                    {},
+                                                    ""));
+        logSS << "Client: '"
+              << newMember->DisplayName
+              << "#"
+              << newMember->ClientID
+              << "' was added to chatroom: '"
+              << room->DisplayName
+              << "#"
+              << room->RoomID
+              << "'";
+        ServerLog.emplace_back(logSS.str());
+    }
 
-                    if (!room) {
-                        currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                    currentRequester->Connection->Address,
-                                                                    "Chatroom not found"));
-                        continue;
-                    }
+    Task Server::HandleRemoveChatroomMember(shared_ptr<RegisteredClient> currentRequester, shared_ptr<ServerAction> currentAct) {
+        stringstream logSS{};
+        stringstream ss(currentAct->Data);
+        unsigned long long id = currentRequester->ClientID;
+
+        unsigned long long rID, memberID;
+        ss >> rID >> memberID;
+        if (!VerifySession(currentRequester)) {
+            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                        currentRequester->Connection->Address,
+                                                        "Invalid credentials"));
+            co_return;
+        }
 
-                    if (room->Admin->ClientID != id && memberID != id) {
-                        currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                    currentRequester->Connection->Address,
-                                                                    "Only the admin or the member themselves can remove members"));
-                        continue;
-                    }
+        ChatroomHost *room = nullptr;
+        RegisteredClient *member = nullptr;
+        {
+            lock_guard<mutex> guard(m_Clients);
+            room = FindRoom(rID);
+            member = FindClient(memberID);
+        }
 
-                    if (!member) {
-                        currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                    currentRequester->Connection->Address,
-                                                                    "Member not found"));
-                        continue;
-                    }
+        if (!room) {
+            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                        currentRequester->Connection->Address,
+                                                        "Chatroom not found"));
+            co_return;
+        }
 
-                    auto it = find_if(room->Members.begin(), room->Members.end(),
-                                      [memberID](RegisteredClient *m) {
-                                          return m->ClientID == memberID;
-                                      });
-
-                    if (it != room->Members.end()) {
-                        room->Members.erase(it);
-                        member->PushResponse(ClientAction(ClientActionType::LeftChatroom,
-                                                          member->Connection->Address,
-                                                          to_string(room->RoomID) + " " + room->DisplayName));
-                        logSS << "Client: '"
-                              << member->DisplayName
-                              << "#"
-                              << member->ClientID
-                              << "' was removed from chatroom: '"
-                              << room->DisplayName
-                              << "#"
-                              << room->RoomID
-                              << "'";
-                        ServerLog.emplace_back(logSS.str());
-                    } else {
-                        currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
-                                                                    currentRequester->Connection->Address,
-                                                                    "Member not found in the chatroom"));
-                    }
-                    break;
-                }
+        if (room->Admin->ClientID != id && memberID != id) {
+            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                        currentRequester->Connection->Address,
+                                                        "Only the admin or the member themselves can remove members"));
+            co_return;
+        }
+
+        if (!member) {
+            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                        currentRequester->Connection->Address,
+                                                        "Member not found"));
+            co_return;
+        }
+
+        bool removed;
+        {
+            lock_guard<mutex> guard(m_Clients);
+            removed = room->Members.Erase(memberID);
+            if (removed) {
+                Wal.AppendMembership(WalRecordType::RemoveMember, rID, memberID);
+                room->Audience.reset();
+                member->JoinedRooms.erase(rID);
+                member->MissedFrom.erase(rID);
+                // Offline members get their current room list at login instead
+                if (IsOnline(member))
+                    member->PushResponse(ClientAction(ClientActionType::LeftChatroom,
+                                                      {},
+                                                      to_string(room->RoomID) + " " + room->DisplayName.Str()));
             }
         }
+
+        if (removed) {
+            logSS << "Client: '"
+                  << member->DisplayName
+                  << "#"
+                  << member->ClientID
+                  << "' was removed from chatroom: '"
+                  << room->DisplayName
+                  << "#"
+                  << room->RoomID
+                  << "'";
+            ServerLog.emplace_back(logSS.str());
+        } else {
+            currentRequester->PushResponse(ClientAction(ClientActionType::InformActionFailure,
+                                                        currentRequester->Connection->Address,
+                                                        "Member not found in the chatroom"));
+        }
     }
 
-    bool Server::VerifyIdentity(unsigned long long int id, const string &key) {
+    bool Server::VerifySession(const shared_ptr<RegisteredClient> &requester) {
         {
             lock_guard<mutex> guard(m_Clients);
-            for (auto &c: Clients) {
-                if (c->ClientID == id) {
-                    if (c->LoginKey == key) {
-                        return c->IsConnected;
-                    } else {
-                        return false;
-                    }
-                }
+            // The requester is the host of the connection the frame arrived on, so a bound session is all it takes.
+            return IsOnline(requester.get()) && requester->Connection && requester->Connection->SessionToken != 0;
+        }
+    }
+
+    void Server::IssueSession(RegisteredClient *client) {
+        unsigned long long token;
+        do {
+            token = SessionRng();
+        } while (token == 0);
+        client->Connection->SessionToken = token;
+    }
+
+    void Server::RevokeSession(RegisteredClient *client) {
+        if (!client->Connection || client->Connection->SessionToken == 0)
+            return;
+        client->Connection->SessionToken = 0;
+    }
+
+    RegisteredClient *Server::FindClient(unsigned long long id) {
+        auto found = ClientIndex.Find(id);
+        return found ? *found : nullptr;
+    }
+
+    ChatroomHost *Server::FindRoom(unsigned long long rID) {
+        auto found = RoomIndex.Find(rID);
+        return found ? Rooms.Get(*found) : nullptr;
+    }
+
+    void Server::BroadcastFrame(ChatroomHost &room, const util::FrameRef &frame) {
+        // The snapshot is shared by every broadcast until the membership changes
+        if (!room.Audience)
+            room.Audience = Fanout.Snapshot(room.Members, Table);
+        Fanout.Submit(room.Audience, frame);
+    }
+
+    bool Server::IsOnline(const RegisteredClient *client) const {
+        return client->Slot != NoSlot && Table.Connected(client->Slot);
+    }
+
+    void Server::MarkConnected(RegisteredClient *client, bool connected) {
+        if (client->Slot == NoSlot)
+            return;
+        bool changed = Table.Connected(client->Slot) != connected;
+        Table.SetConnected(client->Slot, connected);
+        // While connected every announcement is pushed live
+        if (!connected)
+            client->SeenAnnouncement = AnnouncementSeq;
+        if (!changed)
+            return;
+        for (auto rID: client->JoinedRooms) {
+            auto room = FindRoom(rID);
+            if (!room)
+                continue;
+            // Audiences only hold connected members
+            room->Audience.reset();
+            if (!connected)
+                client->MissedFrom.try_emplace(rID, room->Messages.NextSeq());
+        }
+        PublishPresence(*client, connected);
+    }
+
+    void Server::PushCatchUp(RegisteredClient &client) {
+        vector<util::FrameRef> batch;
+        size_t bytes = 0, pushed = 0;
+        auto add = [this, &client, &batch, &bytes, &pushed](util::FrameRef frame) {
+            auto size = FrameEncoder::BatchRecordSize(frame);
+            if (!batch.empty() && bytes + size > MaxBatchBytes) {
+                client.PushFrame(FrameEncoder::MessageBatch(batch));
+                batch.clear();
+                bytes = 0;
+                pushed++;
             }
-            return false;
+            bytes += size;
+            batch.push_back(move(frame));
+        };
+        for (auto &[rID, fromSeq]: client.MissedFrom) {
+            auto room = FindRoom(rID);
+            if (!room || !room->Members.Contains(client.ClientID))
+                continue;
+            auto end = room->Messages.NextSeq();
+            if (fromSeq >= end)
+                continue;
+            // Replay only the newest messages; the rest is announced as a gap the client fetches on its own
+            auto start = max({fromSeq, room->FirstSeq(), end > MaxHistoryFetch ? end - MaxHistoryFetch : 0ULL});
+            vector<LoggedMessage> messages;
+            // MessageBatch frames carry no room, so a full ring would drop them without a trace
+            if (pushed < MaxCatchUpFrames)
+                room->ReadMessages(start, end - start, messages);
+            else
+                start = fromSeq;
+            if (start > fromSeq)
+                add(FrameEncoder::MessageGap(rID, fromSeq - 1, start - fromSeq));
+            auto next = start;
+            for (auto &msg: messages) {
+                if (pushed >= MaxCatchUpFrames)
+                    break;
+                add(FrameEncoder::MessageReceived(msg.SenderID, rID, msg.Seq, msg.Content));
+                next = msg.Seq + 1;
+            }
+            if (next < end)
+                add(FrameEncoder::MessageGap(rID, next - 1, end - next));
         }
+        if (!batch.empty())
+            client.PushFrame(FrameEncoder::MessageBatch(batch));
+        client.MissedFrom.clear();
+    }
+
+    void Server::PublishPresence(RegisteredClient &client, bool online) {
+        vector<unsigned long long> recipients, onlineMates;
+        for (auto rID: client.JoinedRooms) {
+            auto room = FindRoom(rID);
+            if (!room)
+                continue;
+            for (auto slot: room->Members) {
+                auto id = Table.Id(slot);
+                if (id == client.ClientID)
+                    continue;
+                recipients.push_back(id);
+                if (online && Table.Connected(slot))
+                    onlineMates.push_back(id);
+            }
+        }
+        // Room mates can share several rooms
+        sort(recipients.begin(), recipients.end());
+        recipients.erase(unique(recipients.begin(), recipients.end()), recipients.end());
+        Presence.Publish(recipients, {client.ClientID, util::NoRoom,
+                                      online ? PresenceState::Online : PresenceState::Offline});
+        // A client coming online also learns which of its room mates already are
+        sort(onlineMates.begin(), onlineMates.end());
+        onlineMates.erase(unique(onlineMates.begin(), onlineMates.end()), onlineMates.end());
+        for (auto id: onlineMates)
+            Presence.Publish({client.ClientID}, {id, util::NoRoom, PresenceState::Online});
+    }
+
+    bool Server::DeliverPresence(unsigned long long recipient, const vector<util::FrameRef> &frames) {
+        lock_guard<mutex> guard(m_Clients);
+        auto client = FindClient(recipient);
+        // Nobody to tell, an offline client is brought up to date when it logs in again
+        if (!client || !IsOnline(client))
+            return true;
+        // Only written onto an idle queue, so presence never sits in front of chat messages
+        if (client->Outbound->Depth() > 0)
+            return false;
+        for (auto &frame: frames)
+            client->PushFrame(frame);
+        return true;
     }
 }
@@ -14,24 +14,70 @@
 #include <queue>
 #include <map>
 #include <tuple>
+#include <random>
+#include <chrono>
+#include <string_view>
+#include <condition_variable>
 
 #include "../general/ServerAction.h"
 #include "../general/ClientAction.h"
 #include "RegisteredClient.h"
+#include "ClientTable.h"
 #include "ChatroomHost.h"
+#include "ActionLanes.h"
+#include "RateLimiter.h"
+#include "Task.h"
+#include "Scheduler.h"
+#include "BatchController.h"
+#include "FanoutStage.h"
+#include "PresenceHub.h"
+#include "WriteAheadLog.h"
+#include "Snapshot.h"
+#include "util/HashIndex.h"
+#include "util/SlotMap.h"
 
 typedef addrinfo AddressInfo;
 
 using namespace std;
 
 namespace classes::server_side {
+    struct AnnouncementReport {
+        // Pushed onto a connected client's queue
+        size_t Delivered;
+        // Connected, but the client's queue was full
+        size_t Dropped;
+        // Registered clients that are offline and get it at their next login
+        size_t Queued;
+        chrono::microseconds Elapsed;
+    };
+
+    struct SnapshotReport {
+        size_t Clients;
+        size_t Rooms;
+        // Last WAL record the snapshot covers
+        unsigned long long Lsn;
+        // 0 if writing the snapshot failed
+        size_t Bytes;
+        chrono::milliseconds Elapsed;
+    };
+
+    struct WalStats {
+        Durability Mode;
+        unsigned long long LastLsn;
+        unsigned long long DurableLsn;
+        unsigned long long Syncs;
+    };
+
     class Server {
     public:
         string ServerName;
         mutex m_Clients;
         vector<string> ServerLog;
         vector<shared_ptr<RegisteredClient>> Clients;
-        vector<ChatroomHost> Rooms;
+        util::HashIndex<RegisteredClient*> ClientIndex;
+        ClientTable Table;
+        util::SlotMap<ChatroomHost> Rooms;
+        util::HashIndex<util::SlotHandle> RoomIndex;
         thread *ListenerThread;
         thread *EnactRespondThread;
         unique_ptr<AddressInfo> ServerSocket;
@@ -46,14 +92,141 @@ namespace classes::server_side {
         void Stop();
 
         void PushAction(shared_ptr<RegisteredClient> client,shared_ptr<ServerAction> act);
+        LaneMetrics GetLaneMetrics(ActionLane lane);
+        unsigned long long GetQueueLatencyMicros() const;
+        unsigned long long GetRejectedCount() const;
+        unsigned long long GetShedCount() const;
+        size_t GetFanoutBacklog() const;
+        /**
+         * Sends a server-wide announcement to every connected client. The frame is encoded once and pushed in
+         * parallel chunks with no lock held; offline clients receive the latest announcement when they log in.
+         */
+        AnnouncementReport Announce(string_view text);
+        size_t GetPresencePending() const;
+        unsigned long long GetPresenceCoalesced() const;
+        WalStats GetWalStats() const;
+        void SetDurability(Durability mode);
+        /**
+         * Writes clients, rooms, memberships and the ID counters to the snapshot file and retires the WAL up to
+         * that point. The state is copied under m_Clients, the file is written without it.
+         */
+        SnapshotReport TakeSnapshot();
+        unsigned long long GetSnapshotLsn() const;
     private:
         shared_ptr<atomic<bool>> Running;
         mutex m_EnqueuedActions;
-        queue<tuple<shared_ptr<RegisteredClient>,shared_ptr<ServerAction>>> EnqueuedActions;
+        ActionLanes EnqueuedActions;
+        RateLimiter Limiter;
+        unsigned long long LatencyTargetMicros;
+        // Clients read a frame with a single 1 KiB recv()
+        static constexpr size_t MaxBatchBytes = 1000;
+        // Most messages one FetchHistory request returns
+        static constexpr size_t MaxHistoryFetch = 256;
+        // Most frames of replayed messages one login queues, well inside the client's outbound ring
+        static constexpr size_t MaxCatchUpFrames = 64;
+        atomic<unsigned long long> QueueLatencyMicros;
+        atomic<unsigned long long> RejectedCount;
+        atomic<unsigned long long> ShedCount;
+        Scheduler Tasks;
+        BatchController Batching;
+        FanoutStage Fanout;
+        PresenceHub Presence;
+        // Room messages and membership changes, written ahead of being acked
+        WriteAheadLog Wal;
+        static constexpr const char *SnapshotPath = "chat2.snap";
+        static constexpr chrono::seconds SnapshotInterval{60};
+        thread *SnapshotThread;
+        // One snapshot at a time
+        mutex m_Snapshot;
+        mutex m_SnapshotTimer;
+        condition_variable SnapshotCV;
+        atomic<unsigned long long> SnapshotLsn;
+        mt19937_64 SessionRng;
+        // Latest announcement and its number, guarded by m_Clients
+        unsigned long long AnnouncementSeq;
+        util::FrameRef LastAnnouncement;
         void Setup();
-        tuple<shared_ptr<RegisteredClient>,shared_ptr<ServerAction>> NextAction();
+        /**
+         * Rebuilds accounts, rooms and memberships from the last snapshot plus the WAL records after it.
+         */
+        void Recover();
+        /**
+         * Decodes the snapshot's chunks on parallel threads, then indexes the result. Changes nothing if a chunk is
+         * damaged. The caller must hold m_Clients.
+         */
+        bool RestoreSnapshot(const SnapshotReader &snapshot);
+        /**
+         * Idempotent, so records a snapshot already covers do no harm. The caller must hold m_Clients.
+         */
+        void ApplyWalRecord(const WalRecord &record);
+        //region Recovery helpers, the caller must hold m_Clients
+        void RestoreClient(shared_ptr<RegisteredClient> client);
+        ChatroomHost *RestoreRoom(unsigned long long rID, unsigned long long adminID, string_view name);
+        //endregion
+        void SnapshotLoop();
+        size_t NextActions(vector<ActionLanes::Entry> &out, size_t maxCount);
+        static bool PeekRoomID(const ServerAction &act, unsigned long long &rID);
+        static string_view MessageBody(const ServerAction &act);
+        /**
+         * Next frame to write on the client's connection. Queued messages that arrive within the connection's
+         * coalescing window are packed into one MessageBatch frame of at most MaxBatchBytes.
+         */
+        util::FrameRef NextOutbound(RegisteredClient &client);
+        /**
+         * MessageGap frame(s) for the room messages the client's queue skipped, empty if there are none.
+         */
+        util::FrameRef GapMarker(RegisteredClient &client);
+        unsigned long long Admit(const shared_ptr<RegisteredClient> &client, const ServerAction &act);
         void EnactRespond();
-        bool VerifyIdentity(unsigned long long id, const string& key);
+        Task Dispatch(shared_ptr<RegisteredClient> requester, shared_ptr<ServerAction> act);
+
+        //region Handlers
+        Task HandleSendMessages(unsigned long long rID, vector<ActionLanes::Entry> batch);
+        Task HandleRegisterClient(shared_ptr<RegisteredClient> currentRequester, shared_ptr<ServerAction> currentAct);
+        Task HandleLoginClient(shared_ptr<RegisteredClient> currentRequester, shared_ptr<ServerAction> currentAct);
+        Task HandleLogoutClient(shared_ptr<RegisteredClient> currentRequester, shared_ptr<ServerAction> currentAct);
+        Task HandleCreateChatroom(shared_ptr<RegisteredClient> currentRequester, shared_ptr<ServerAction> currentAct);
+        Task HandleRemoveChatroom(shared_ptr<RegisteredClient> currentRequester, shared_ptr<ServerAction> currentAct);
+        Task HandleAddChatRoomMember(shared_ptr<RegisteredClient> currentRequester,
+                                     shared_ptr<ServerAction> currentAct);
+        Task HandleRemoveChatroomMember(shared_ptr<RegisteredClient> currentRequester,
+                                        shared_ptr<ServerAction> currentAct);
+        Task HandleFetchHistory(shared_ptr<RegisteredClient> currentRequester, shared_ptr<ServerAction> currentAct);
+        Task HandleSetTyping(shared_ptr<RegisteredClient> currentRequester, shared_ptr<ServerAction> currentAct);
+        //endregion
+        bool VerifySession(const shared_ptr<RegisteredClient> &requester);
+        /**
+         * Session helpers, the caller must hold m_Clients.
+         */
+        void IssueSession(RegisteredClient *client);
+        void RevokeSession(RegisteredClient *client);
+        /**
+         * O(1) lookup through ClientIndex, the caller must hold m_Clients.
+         */
+        RegisteredClient *FindClient(unsigned long long id);
+        ChatroomHost *FindRoom(unsigned long long rID);
+        /**
+         * Connected flag in the hot table, the caller must hold m_Clients.
+         */
+        bool IsOnline(const RegisteredClient *client) const;
+        /**
+         * Hands one shared frame to the fan-out stage for every member, the caller must hold m_Clients.
+         */
+        void BroadcastFrame(ChatroomHost &room, const util::FrameRef &frame);
+        /**
+         * Also publishes the online/offline change to the client's room mates, the caller must hold m_Clients.
+         */
+        void MarkConnected(RegisteredClient *client, bool connected);
+        void PublishPresence(RegisteredClient &client, bool online);
+        /**
+         * Replays what the client missed in its rooms while offline as MessageBatch frames. Past MaxCatchUpFrames
+         * the rest is sent as MessageGap records for the client to fetch. The caller must hold m_Clients.
+         */
+        void PushCatchUp(RegisteredClient &client);
+        /**
+         * PresenceHub's delivery, runs on the hub's thread and takes m_Clients.
+         */
+        bool DeliverPresence(unsigned long long recipient, const vector<util::FrameRef> &frames);
     };
 } // namespace classes::server_side
 
@@ -0,0 +1,201 @@
+#include "Snapshot.h"
+#include "util/Bytes.h"
+#include "util/Crc32.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+
+namespace classes::server_side {
+    namespace {
+        const char Magic[8] = {'C', 'H', 'A', 'T', '2', 'S', 'N', 'P'};
+        const uint32_t Version = 1;
+        // Magic, version, chunk count, WAL LSN, next client ID, next room ID
+        const size_t HeaderSize = 8 + 4 + 4 + 8 * 3;
+        // Section, checksum, offset, size, count
+        const size_t TableEntrySize = 4 + 4 + 8 * 3;
+
+        bool WriteAll(int fd, const char *data, size_t size) {
+            while (size > 0) {
+                auto written = write(fd, data, size);
+                if (written == -1 && errno == EINTR)
+                    continue;
+                if (written <= 0)
+                    return false;
+                data += written;
+                size -= written;
+            }
+            return true;
+        }
+    } // namespace
+
+    void SnapshotWriter::AddClient(const ClientImage &client) {
+        auto &chunk = Current(SnapshotSection::Clients, ClientsPerChunk);
+        util::AppendU64(chunk.Bytes, client.ClientID);
+        util::AppendText(chunk.Bytes, client.DisplayName);
+        util::AppendText(chunk.Bytes, client.LoginKey);
+        chunk.Count++;
+    }
+
+    void SnapshotWriter::AddRoom(const RoomImage &room) {
+        auto &chunk = Current(SnapshotSection::Rooms, RoomsPerChunk);
+        util::AppendU64(chunk.Bytes, room.RoomID);
+        util::AppendU64(chunk.Bytes, room.AdminID);
+        util::AppendU64(chunk.Bytes, room.NextSeq);
+        util::AppendText(chunk.Bytes, room.DisplayName);
+        util::AppendU32(chunk.Bytes, static_cast<uint32_t>(room.Members.size()));
+        for (auto member: room.Members)
+            util::AppendU64(chunk.Bytes, member);
+        chunk.Count++;
+    }
+
+    size_t SnapshotWriter::Commit(const string &path, const SnapshotInfo &info) {
+        // Header and chunk table, followed by a checksum over both
+        string head(Magic, sizeof(Magic));
+        util::AppendU32(head, Version);
+        util::AppendU32(head, static_cast<uint32_t>(Chunks.size()));
+        util::AppendU64(head, info.WalLsn);
+        util::AppendU64(head, info.NextClientID);
+        util::AppendU64(head, info.NextRoomID);
+        size_t offset = HeaderSize + Chunks.size() * TableEntrySize + 4;
+        for (auto &chunk: Chunks) {
+            util::AppendU32(head, static_cast<uint32_t>(chunk.Section));
+            util::AppendU32(head, util::Crc32(chunk.Bytes.data(), chunk.Bytes.size()));
+            util::AppendU64(head, offset);
+            util::AppendU64(head, chunk.Bytes.size());
+            util::AppendU64(head, chunk.Count);
+            offset += chunk.Bytes.size();
+        }
+        util::AppendU32(head, util::Crc32(head.data(), head.size()));
+
+        auto temporary = path + ".tmp";
+        int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd == -1) {
+            perror("snapshot open");
+            return 0;
+        }
+        bool written = WriteAll(fd, head.data(), head.size());
+        for (auto &chunk: Chunks)
+            written = written && WriteAll(fd, chunk.Bytes.data(), chunk.Bytes.size());
+        written = written && fsync(fd) == 0;
+        close(fd);
+        if (!written || rename(temporary.c_str(), path.c_str()) == -1) {
+            perror("snapshot write");
+            unlink(temporary.c_str());
+            return 0;
+        }
+        return offset;
+    }
+
+    SnapshotWriter::Chunk &SnapshotWriter::Current(SnapshotSection section, size_t perChunk) {
+        if (Chunks.empty() || Chunks.back().Section != section || Chunks.back().Count == perChunk)
+            Chunks.push_back(Chunk{section, 0, {}});
+        return Chunks.back();
+    }
+
+    SnapshotReader::SnapshotReader(const string &path) : Base(nullptr), Size(0), Header{}, Intact(false) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+            return;
+        struct stat info{};
+        if (fstat(fd, &info) == 0 && (size_t) info.st_size >= HeaderSize) {
+            void *base = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (base != MAP_FAILED) {
+                Base = static_cast<char *>(base);
+                Size = info.st_size;
+                // Every page gets read, start pulling them in now
+                madvise(Base, Size, MADV_WILLNEED);
+            }
+        }
+        close(fd);
+        if (!Base)
+            return;
+
+        if (memcmp(Base, Magic, sizeof(Magic)) != 0)
+            return;
+        util::ByteReader head(string_view(Base + sizeof(Magic), Size - sizeof(Magic)));
+        uint32_t version, count;
+        if (!head.U32(version) || version != Version || !head.U32(count) || !head.U64(Header.WalLsn) ||
+            !head.U64(Header.NextClientID) || !head.U64(Header.NextRoomID))
+            return;
+        size_t tableEnd = HeaderSize + (size_t) count * TableEntrySize;
+        if (Size < tableEnd + 4 || util::Crc32(Base, tableEnd) != util::GetU32(Base + tableEnd))
+            return;
+        vector<Chunk> table;
+        table.reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t section, crc;
+            unsigned long long offset, size, records;
+            head.U32(section);
+            head.U32(crc);
+            head.U64(offset);
+            head.U64(size);
+            head.U64(records);
+            if (offset > Size || size > Size - offset)
+                return;
+            table.push_back(Chunk{static_cast<SnapshotSection>(section), records, string_view(Base + offset, size),
+                                  crc});
+        }
+        Table = move(table);
+        Intact = true;
+    }
+
+    SnapshotReader::~SnapshotReader() {
+        if (Base)
+            munmap(Base, Size);
+    }
+
+    bool SnapshotReader::Valid() const {
+        return Intact;
+    }
+
+    const SnapshotInfo &SnapshotReader::Info() const {
+        return Header;
+    }
+
+    const vector<SnapshotReader::Chunk> &SnapshotReader::Chunks() const {
+        return Table;
+    }
+
+    bool SnapshotReader::DecodeClients(size_t chunk, vector<ClientImage> &out) const {
+        auto &entry = Table[chunk];
+        if (entry.Section != SnapshotSection::Clients ||
+            util::Crc32(entry.Bytes.data(), entry.Bytes.size()) != entry.Crc)
+            return false;
+        util::ByteReader reader(entry.Bytes);
+        out.reserve(out.size() + entry.Count);
+        for (size_t i = 0; i < entry.Count; i++) {
+            ClientImage client{};
+            if (!reader.U64(client.ClientID) || !reader.Text(client.DisplayName) || !reader.Text(client.LoginKey))
+                return false;
+            out.push_back(client);
+        }
+        return true;
+    }
+
+    bool SnapshotReader::DecodeRooms(size_t chunk, vector<RoomImage> &out) const {
+        auto &entry = Table[chunk];
+        if (entry.Section != SnapshotSection::Rooms ||
+            util::Crc32(entry.Bytes.data(), entry.Bytes.size()) != entry.Crc)
+            return false;
+        util::ByteReader reader(entry.Bytes);
+        out.reserve(out.size() + entry.Count);
+        for (size_t i = 0; i < entry.Count; i++) {
+            RoomImage room{};
+            uint32_t members;
+            if (!reader.U64(room.RoomID) || !reader.U64(room.AdminID) || !reader.U64(room.NextSeq) ||
+                !reader.Text(room.DisplayName) || !reader.U32(members))
+                return false;
+            room.Members.resize(members);
+            for (auto &member: room.Members)
+                if (!reader.U64(member))
+                    return false;
+            out.push_back(move(room));
+        }
+        return true;
+    }
+} // namespace classes::server_side
@@ -0,0 +1,108 @@
+#ifndef CHAT2_SNAPSHOT_H
+#define CHAT2_SNAPSHOT_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+namespace classes::server_side {
+    struct ClientImage {
+        unsigned long long ClientID;
+        string_view DisplayName;
+        string_view LoginKey;
+    };
+
+    struct RoomImage {
+        unsigned long long RoomID;
+        unsigned long long AdminID;
+        // Sequence number the room's next message gets
+        unsigned long long NextSeq;
+        string_view DisplayName;
+        vector<unsigned long long> Members;
+    };
+
+    /**
+     * Header fields of a snapshot. WalLsn is the last WAL record the snapshot reflects.
+     */
+    struct SnapshotInfo {
+        unsigned long long WalLsn;
+        unsigned long long NextClientID;
+        unsigned long long NextRoomID;
+    };
+
+    enum class SnapshotSection : uint32_t {
+        Clients = 1,
+        Rooms
+    };
+
+    /**
+     * Builds a snapshot file: a header, a table of chunk offsets, then the chunks. Every chunk holds a bounded
+     * number of clients or rooms and its own CRC-32, so a reader can decode the chunks on separate threads.
+     */
+    class SnapshotWriter {
+    public:
+        static constexpr size_t ClientsPerChunk = 65536;
+        static constexpr size_t RoomsPerChunk = 4096;
+
+        void AddClient(const ClientImage &client);
+        void AddRoom(const RoomImage &room);
+        /**
+         * Writes a temporary file, syncs it and renames it over path, so a crash leaves the previous snapshot.
+         * Returns the size written, 0 on failure.
+         */
+        size_t Commit(const string &path, const SnapshotInfo &info);
+    private:
+        struct Chunk {
+            SnapshotSection Section;
+            size_t Count;
+            string Bytes;
+        };
+
+        vector<Chunk> Chunks;
+
+        Chunk &Current(SnapshotSection section, size_t perChunk);
+    };
+
+    /**
+     * Memory-maps a snapshot file read-only. Decoding a chunk touches nothing but its own bytes, so chunks can be
+     * decoded concurrently; names in the images point into the mapping and live as long as the reader.
+     */
+    class SnapshotReader {
+    public:
+        struct Chunk {
+            SnapshotSection Section;
+            size_t Count;
+            string_view Bytes;
+            uint32_t Crc;
+        };
+
+        explicit SnapshotReader(const string &path);
+        ~SnapshotReader();
+        SnapshotReader(const SnapshotReader &) = delete;
+        SnapshotReader &operator=(const SnapshotReader &) = delete;
+
+        /**
+         * False if the file is missing or its header or chunk table is damaged.
+         */
+        bool Valid() const;
+        const SnapshotInfo &Info() const;
+        const vector<Chunk> &Chunks() const;
+
+        /**
+         * Both check the chunk's checksum first and fail on a mismatch.
+         */
+        bool DecodeClients(size_t chunk, vector<ClientImage> &out) const;
+        bool DecodeRooms(size_t chunk, vector<RoomImage> &out) const;
+    private:
+        char *Base;
+        size_t Size;
+        SnapshotInfo Header;
+        vector<Chunk> Table;
+        bool Intact;
+    };
+} // namespace classes::server_side
+
+#endif //CHAT2_SNAPSHOT_H
@@ -0,0 +1,71 @@
+#include "Task.h"
+
+#include <iostream>
+#include <utility>
+
+namespace classes::server_side {
+    coroutine_handle<> Task::FinalAwaiter::await_suspend(Handle finished) noexcept {
+        auto &promise = finished.promise();
+        if (promise.Continuation)
+            return promise.Continuation;
+        if (promise.Detached) {
+            if (promise.Exception) {
+                try {
+                    rethrow_exception(promise.Exception);
+                } catch (const exception &e) {
+                    cerr << "Unhandled exception in detached task: " << e.what() << "\n";
+                } catch (...) {
+                    cerr << "Unhandled exception in detached task\n";
+                }
+            }
+            finished.destroy();
+        }
+        return noop_coroutine();
+    }
+
+    Task Task::promise_type::get_return_object() noexcept {
+        return Task(Handle::from_promise(*this));
+    }
+
+    void Task::promise_type::unhandled_exception() noexcept {
+        Exception = current_exception();
+    }
+
+    Task::Task() noexcept: Coroutine(nullptr) {}
+
+    Task::Task(Handle coroutine) noexcept: Coroutine(coroutine) {}
+
+    Task::Task(Task &&other) noexcept: Coroutine(exchange(other.Coroutine, nullptr)) {}
+
+    Task &Task::operator=(Task &&other) noexcept {
+        if (this != &other) {
+            if (Coroutine)
+                Coroutine.destroy();
+            Coroutine = exchange(other.Coroutine, nullptr);
+        }
+        return *this;
+    }
+
+    Task::~Task() {
+        if (Coroutine)
+            Coroutine.destroy();
+    }
+
+    bool Task::await_ready() const noexcept {
+        return !Coroutine || Coroutine.done();
+    }
+
+    coroutine_handle<> Task::await_suspend(coroutine_handle<> awaiting) noexcept {
+        Coroutine.promise().Continuation = awaiting;
+        return Coroutine;
+    }
+
+    void Task::await_resume() {
+        if (Coroutine && Coroutine.promise().Exception)
+            rethrow_exception(Coroutine.promise().Exception);
+    }
+
+    Task::Handle Task::Release() noexcept {
+        return exchange(Coroutine, nullptr);
+    }
+} // namespace classes::server_side
@@ -0,0 +1,55 @@
+#ifndef CHAT2_TASK_H
+#define CHAT2_TASK_H
+
+#include <coroutine>
+#include <exception>
+
+using namespace std;
+
+namespace classes::server_side {
+    /**
+     * Lazily started coroutine returning nothing. A Task is either co_awaited by another Task, which it resumes
+     * when it finishes, or handed to Scheduler::Spawn(), after which it destroys itself on completion.
+     */
+    class Task {
+    public:
+        struct promise_type;
+        typedef coroutine_handle<promise_type> Handle;
+
+        struct FinalAwaiter {
+            bool await_ready() const noexcept { return false; }
+            coroutine_handle<> await_suspend(Handle finished) noexcept;
+            void await_resume() const noexcept {}
+        };
+
+        struct promise_type {
+            coroutine_handle<> Continuation;
+            exception_ptr Exception;
+            bool Detached = false;
+
+            Task get_return_object() noexcept;
+            suspend_always initial_suspend() const noexcept { return {}; }
+            FinalAwaiter final_suspend() const noexcept { return {}; }
+            void return_void() const noexcept {}
+            void unhandled_exception() noexcept;
+        };
+
+        Task() noexcept;
+        explicit Task(Handle coroutine) noexcept;
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+        Task(Task &&other) noexcept;
+        Task &operator=(Task &&other) noexcept;
+        ~Task();
+
+        bool await_ready() const noexcept;
+        coroutine_handle<> await_suspend(coroutine_handle<> awaiting) noexcept;
+        void await_resume();
+
+        Handle Release() noexcept;
+    private:
+        Handle Coroutine;
+    };
+} // namespace classes::server_side
+
+#endif //CHAT2_TASK_H
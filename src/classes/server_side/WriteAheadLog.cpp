@@ -0,0 +1,330 @@
+#include "WriteAheadLog.h"
+#include "util/Crc32.h"
+#include "util/Bytes.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cerrno>
+#include <algorithm>
+
+namespace classes::server_side {
+    namespace {
+        // Length, LSN and type in front of the payload
+        const size_t HeaderSize = 4 + 8 + 1;
+        const size_t TrailerSize = 4;
+
+        bool ReadFile(const string &path, string &out) {
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd == -1)
+                return false;
+            struct stat info{};
+            if (fstat(fd, &info) == 0)
+                out.resize(info.st_size);
+            size_t done = 0;
+            while (done < out.size()) {
+                auto got = read(fd, out.data() + done, out.size() - done);
+                if (got <= 0)
+                    break;
+                done += got;
+            }
+            out.resize(done);
+            close(fd);
+            return true;
+        }
+
+        /**
+         * Walks the intact records, returns the offset just past the last one. A record must continue the LSN
+         * sequence of the one before it, anything else is treated as the torn end of the log.
+         */
+        size_t Scan(string_view data, unsigned long long &lastLsn, const function<void(const WalRecord &)> *apply,
+                    unsigned long long afterLsn) {
+            size_t pos = 0;
+            lastLsn = 0;
+            while (data.size() - pos >= 4 + TrailerSize) {
+                auto length = util::GetU32(data.data() + pos);
+                if (length < HeaderSize - 4 || data.size() - pos - 4 - TrailerSize < length)
+                    break;
+                auto body = data.data() + pos + 4;
+                if (util::Crc32(body, length) != util::GetU32(body + length))
+                    break;
+                auto lsn = util::GetU64(body);
+                if (lastLsn != 0 && lsn != lastLsn + 1)
+                    break;
+                lastLsn = lsn;
+                if (apply && lsn > afterLsn)
+                    (*apply)(WalRecord{lsn, static_cast<WalRecordType>(body[8]),
+                                       string_view(body + 9, length - 9)});
+                pos += 4 + length + TrailerSize;
+            }
+            return pos;
+        }
+    } // namespace
+
+    WriteAheadLog::WriteAheadLog(string path, Durability mode) :
+            FilePath(move(path)), FD(-1), CurrentMode(mode), NextLsn(1), Durable_(0), SyncCount(0), Head(nullptr) {
+        auto last = Recover();
+        NextLsn.store(last + 1);
+        Durable_.store(last);
+        FD = open(FilePath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (FD == -1)
+            perror("WAL open");
+        Writer = thread([this]() { Run(); });
+    }
+
+    WriteAheadLog::~WriteAheadLog() {
+        Push(new Entry{nullptr, EntryKind::Stop, 0, {}});
+        if (Writer.joinable())
+            Writer.join();
+        if (FD != -1)
+            close(FD);
+    }
+
+    unsigned long long WriteAheadLog::AppendMessage(unsigned long long rID, unsigned long long seq,
+                                                    unsigned long long senderID, string_view content) {
+        auto record = Begin(WalRecordType::Message, 8 * 3 + 4 + content.size());
+        util::AppendU64(record, rID);
+        util::AppendU64(record, seq);
+        util::AppendU64(record, senderID);
+        util::AppendText(record, content);
+        return Seal(move(record));
+    }
+
+    unsigned long long WriteAheadLog::AppendCreateRoom(unsigned long long rID, unsigned long long adminID,
+                                                       string_view name) {
+        auto record = Begin(WalRecordType::CreateRoom, 8 * 2 + 4 + name.size());
+        util::AppendU64(record, rID);
+        util::AppendU64(record, adminID);
+        util::AppendText(record, name);
+        return Seal(move(record));
+    }
+
+    unsigned long long WriteAheadLog::AppendRemoveRoom(unsigned long long rID) {
+        auto record = Begin(WalRecordType::RemoveRoom, 8);
+        util::AppendU64(record, rID);
+        return Seal(move(record));
+    }
+
+    unsigned long long WriteAheadLog::AppendMembership(WalRecordType type, unsigned long long rID,
+                                                       unsigned long long memberID) {
+        auto record = Begin(type, 8 * 2);
+        util::AppendU64(record, rID);
+        util::AppendU64(record, memberID);
+        return Seal(move(record));
+    }
+
+    unsigned long long WriteAheadLog::AppendRegisterClient(unsigned long long clientID, string_view name,
+                                                           string_view loginKey) {
+        auto record = Begin(WalRecordType::RegisterClient, 8 + 4 + name.size() + 4 + loginKey.size());
+        util::AppendU64(record, clientID);
+        util::AppendText(record, name);
+        util::AppendText(record, loginKey);
+        return Seal(move(record));
+    }
+
+    void WriteAheadLog::Rotate(unsigned long long lsn) {
+        Push(new Entry{nullptr, EntryKind::Rotate, lsn, {}});
+    }
+
+    string WriteAheadLog::RetiredPath() const {
+        return FilePath + RetiredSuffix;
+    }
+
+    const string &WriteAheadLog::Path() const {
+        return FilePath;
+    }
+
+    void WriteAheadLog::ResumeAfter(unsigned long long lsn) {
+        if (LastLsn() >= lsn)
+            return;
+        NextLsn.store(lsn + 1);
+        Durable_.store(lsn, memory_order_release);
+    }
+
+    unsigned long long WriteAheadLog::DurableLsn() const {
+        return Durable_.load(memory_order_acquire);
+    }
+
+    unsigned long long WriteAheadLog::LastLsn() const {
+        return NextLsn.load(memory_order_relaxed) - 1;
+    }
+
+    WriteAheadLog::DurableAwaiter WriteAheadLog::Durable(unsigned long long lsn, Scheduler &scheduler) {
+        return DurableAwaiter{this, &scheduler, lsn};
+    }
+
+    void WriteAheadLog::DurableAwaiter::await_suspend(coroutine_handle<> awaiting) {
+        auto owner = Owner;
+        Log->OnDurable(Lsn, [owner, awaiting]() { owner->Schedule(awaiting); });
+    }
+
+    void WriteAheadLog::OnDurable(unsigned long long lsn, function<void()> callback) {
+        {
+            //Critical Section
+            lock_guard<mutex> guard(m_Waiters);
+            // Commit() publishes the LSN before taking the lock, so a miss here is picked up there
+            if (Durable_.load(memory_order_acquire) < lsn) {
+                Waiters.emplace(lsn, move(callback));
+                return;
+            }
+        }
+        callback();
+    }
+
+    Durability WriteAheadLog::Mode() const {
+        return CurrentMode.load(memory_order_relaxed);
+    }
+
+    void WriteAheadLog::SetMode(Durability mode) {
+        CurrentMode.store(mode, memory_order_relaxed);
+    }
+
+    unsigned long long WriteAheadLog::Syncs() const {
+        return SyncCount.load(memory_order_relaxed);
+    }
+
+    unsigned long long WriteAheadLog::Replay(const string &path, unsigned long long afterLsn,
+                                             const function<void(const WalRecord &)> &apply) {
+        string data;
+        if (!ReadFile(path, data))
+            return 0;
+        unsigned long long last = 0;
+        Scan(data, last, &apply, afterLsn);
+        return last;
+    }
+
+    string WriteAheadLog::Begin(WalRecordType type, size_t payloadSize) {
+        string record;
+        record.reserve(HeaderSize + payloadSize + TrailerSize);
+        record.resize(HeaderSize);
+        record[HeaderSize - 1] = static_cast<char>(type);
+        return record;
+    }
+
+    unsigned long long WriteAheadLog::Seal(string record) {
+        auto lsn = NextLsn.fetch_add(1, memory_order_relaxed);
+        util::PutU32(record.data(), static_cast<uint32_t>(record.size() - 4));
+        util::PutU64(record.data() + 4, lsn);
+        util::AppendU32(record, util::Crc32(record.data() + 4, record.size() - 4));
+        Push(new Entry{nullptr, EntryKind::Record, lsn, move(record)});
+        return lsn;
+    }
+
+    void WriteAheadLog::Push(Entry *entry) {
+        Entry *head = Head.load(memory_order_relaxed);
+        do {
+            entry->Next = head;
+        } while (!Head.compare_exchange_weak(head, entry, memory_order_release, memory_order_relaxed));
+        // The writer only sleeps on an empty list, so only the push that ends the empty state has to wake it
+        if (!head)
+            Head.notify_one();
+    }
+
+    void WriteAheadLog::Run() {
+        // Appenders take an LSN before pushing, so a later record can arrive first; it waits here for the gap
+        map<unsigned long long, string> waiting;
+        bool stop = false;
+        unsigned long long rotateAt = 0;
+        string group;
+        while (true) {
+            Entry *batch = Head.exchange(nullptr, memory_order_acquire);
+            bool received = batch != nullptr;
+            while (batch) {
+                auto next = batch->Next;
+                if (batch->Kind == EntryKind::Stop)
+                    stop = true;
+                else if (batch->Kind == EntryKind::Rotate)
+                    rotateAt = max(rotateAt, batch->Lsn);
+                else
+                    waiting.emplace(batch->Lsn, move(batch->Bytes));
+                delete batch;
+                batch = next;
+            }
+
+            // Group commit: everything gap-free goes out in one write and one sync, cut at a pending rotation
+            auto durable = Durable_.load(memory_order_relaxed);
+            group.clear();
+            for (auto it = waiting.begin(); it != waiting.end() && it->first == durable + 1 &&
+                                            (rotateAt == 0 || it->first <= rotateAt); it = waiting.erase(it)) {
+                group += it->second;
+                durable = it->first;
+            }
+            if (!group.empty() && FD != -1) {
+                size_t done = 0;
+                while (done < group.size()) {
+                    auto written = write(FD, group.data() + done, group.size() - done);
+                    if (written == -1 && errno == EINTR)
+                        continue;
+                    if (written <= 0) {
+                        perror("WAL write");
+                        break;
+                    }
+                    done += written;
+                }
+                if (CurrentMode.load(memory_order_relaxed) != Durability::None) {
+                    if (fdatasync(FD) == -1)
+                        perror("WAL fdatasync");
+                    SyncCount.fetch_add(1, memory_order_relaxed);
+                }
+            }
+            if (!group.empty())
+                Commit(durable);
+            if (rotateAt != 0 && durable >= rotateAt) {
+                Retire();
+                rotateAt = 0;
+                // Records past the rotation may already be waiting
+                continue;
+            }
+            if (!received && group.empty()) {
+                if (stop)
+                    break;
+                Head.wait(nullptr, memory_order_acquire);
+            }
+        }
+    }
+
+    void WriteAheadLog::Commit(unsigned long long durable) {
+        Durable_.store(durable, memory_order_release);
+        vector<function<void()>> ready;
+        {
+            //Critical Section
+            lock_guard<mutex> guard(m_Waiters);
+            auto end = Waiters.upper_bound(durable);
+            for (auto it = Waiters.begin(); it != end; ++it)
+                ready.push_back(move(it->second));
+            Waiters.erase(Waiters.begin(), end);
+        }
+        for (auto &callback: ready)
+            callback();
+    }
+
+    void WriteAheadLog::Retire() {
+        if (access(RetiredPath().c_str(), F_OK) == 0)
+            return;
+        if (FD != -1) {
+            // The retired file must be complete whatever the durability mode
+            fdatasync(FD);
+            close(FD);
+        }
+        if (rename(FilePath.c_str(), RetiredPath().c_str()) == -1)
+            perror("WAL rotate");
+        FD = open(FilePath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (FD == -1)
+            perror("WAL open");
+    }
+
+    unsigned long long WriteAheadLog::Recover() {
+        string data;
+        if (!ReadFile(FilePath, data))
+            return 0;
+        unsigned long long last = 0;
+        auto intact = Scan(data, last, nullptr, 0);
+        if (intact < data.size()) {
+            // Torn or corrupt tail from a crash mid-write, later appends must not land behind it
+            if (truncate(FilePath.c_str(), static_cast<off_t>(intact)) == -1)
+                perror("WAL truncate");
+        }
+        return last;
+    }
+} // namespace classes::server_side
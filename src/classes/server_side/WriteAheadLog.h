@@ -0,0 +1,171 @@
+#ifndef CHAT2_WRITEAHEADLOG_H
+#define CHAT2_WRITEAHEADLOG_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+
+#include "Scheduler.h"
+
+using namespace std;
+
+namespace classes::server_side {
+    enum class WalRecordType : uint8_t {
+        Message = 1,
+        CreateRoom,
+        RemoveRoom,
+        AddMember,
+        RemoveMember,
+        RegisterClient
+    };
+
+    enum class Durability {
+        // Written to the file, never synced; the OS decides when it reaches the disk
+        None,
+        // Synced once per group of records, acks do not wait for it
+        Batched,
+        // Synced once per group of records, and a message is only acked once its record is synced
+        PerMessage
+    };
+
+    struct WalRecord {
+        unsigned long long Lsn;
+        WalRecordType Type;
+        string_view Payload;
+    };
+
+    /**
+     * Append-only log of room messages and membership changes. A record on disk is
+     * [u32 length][u64 lsn][u8 type][payload][u32 crc32], where length covers lsn, type and payload and the
+     * checksum covers the same bytes. LSNs are consecutive and continue across restarts.
+     *
+     * Appending only encodes the record and pushes it onto a lock-free list. A dedicated I/O thread takes the
+     * whole list at once, writes the records in LSN order with one write() and, unless the mode is None, one
+     * fdatasync() per group.
+     *
+     * Rotate() retires the file at a given LSN once a snapshot covers it: later records go to a fresh file and
+     * recovery replays the retired file, then the current one, from the snapshot's LSN on.
+     */
+    class WriteAheadLog {
+    public:
+        static constexpr const char *DefaultPath = "chat2.wal";
+        static constexpr const char *RetiredSuffix = ".old";
+
+        struct DurableAwaiter {
+            WriteAheadLog *Log;
+            Scheduler *Owner;
+            unsigned long long Lsn;
+
+            bool await_ready() const noexcept { return Log->DurableLsn() >= Lsn; }
+            void await_suspend(coroutine_handle<> awaiting);
+            void await_resume() const noexcept {}
+        };
+
+        explicit WriteAheadLog(string path = DefaultPath, Durability mode = Durability::Batched);
+        /**
+         * Writes and syncs everything appended so far before returning.
+         */
+        ~WriteAheadLog();
+        WriteAheadLog(const WriteAheadLog &) = delete;
+        WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+        //region Append
+        // All return the record's LSN. Lock-free, safe from any thread.
+        unsigned long long AppendMessage(unsigned long long rID, unsigned long long seq, unsigned long long senderID,
+                                         string_view content);
+        unsigned long long AppendCreateRoom(unsigned long long rID, unsigned long long adminID, string_view name);
+        unsigned long long AppendRemoveRoom(unsigned long long rID);
+        unsigned long long AppendMembership(WalRecordType type, unsigned long long rID, unsigned long long memberID);
+        unsigned long long AppendRegisterClient(unsigned long long clientID, string_view name, string_view loginKey);
+        //endregion
+
+        /**
+         * Highest LSN such that it and every record before it has been written, and synced unless the mode is None.
+         */
+        unsigned long long DurableLsn() const;
+        unsigned long long LastLsn() const;
+        /**
+         * Resumes the awaiting coroutine on `scheduler` once `lsn` is durable.
+         */
+        DurableAwaiter Durable(unsigned long long lsn, Scheduler &scheduler);
+        /**
+         * Runs `callback` on the I/O thread once `lsn` is durable, or right away if it already is.
+         */
+        void OnDurable(unsigned long long lsn, function<void()> callback);
+
+        /**
+         * Once every record up to lsn is written, moves the file to RetiredPath() and continues in a new one.
+         * Skipped while an earlier retired file is still there, its records would be lost otherwise.
+         */
+        void Rotate(unsigned long long lsn);
+        string RetiredPath() const;
+        const string &Path() const;
+        /**
+         * Continues numbering after lsn. For recovery, when the current file is empty after a rotation.
+         * Call before the first append.
+         */
+        void ResumeAfter(unsigned long long lsn);
+
+        Durability Mode() const;
+        void SetMode(Durability mode);
+        unsigned long long Syncs() const;
+
+        /**
+         * Calls `apply` for every intact record with an LSN above `afterLsn`, in order. Stops at the first torn or
+         * corrupt record, returns the last LSN in the file or 0 if it has none.
+         */
+        static unsigned long long Replay(const string &path, unsigned long long afterLsn,
+                                         const function<void(const WalRecord &)> &apply);
+    private:
+        enum class EntryKind : uint8_t {
+            Record,
+            // From the destructor, Lsn is unused
+            Stop,
+            // From Rotate(), retire the file after Lsn
+            Rotate
+        };
+
+        struct Entry {
+            Entry *Next;
+            EntryKind Kind;
+            unsigned long long Lsn;
+            string Bytes;
+        };
+
+        string FilePath;
+        int FD;
+        atomic<Durability> CurrentMode;
+        atomic<unsigned long long> NextLsn;
+        atomic<unsigned long long> Durable_;
+        atomic<unsigned long long> SyncCount;
+        atomic<Entry *> Head;
+
+        mutex m_Waiters;
+        multimap<unsigned long long, function<void()>> Waiters;
+
+        thread Writer;
+
+        /**
+         * Starts a record with room for the header; Seal() fills in length, LSN and checksum and queues it.
+         */
+        static string Begin(WalRecordType type, size_t payloadSize);
+        unsigned long long Seal(string record);
+        void Push(Entry *entry);
+        void Run();
+        void Commit(unsigned long long durable);
+        void Retire();
+        /**
+         * Scans the existing file for the last intact LSN and cuts off a torn tail.
+         */
+        unsigned long long Recover();
+    };
+} // namespace classes::server_side
+
+#endif //CHAT2_WRITEAHEADLOG_H
@@ -0,0 +1,98 @@
+#ifndef CHAT2_BYTES_H
+#define CHAT2_BYTES_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+namespace classes::server_side::util {
+    //region Little-endian encoding of on-disk fields
+    inline void PutU32(char *at, uint32_t value) {
+        for (int i = 0; i < 4; i++)
+            at[i] = static_cast<char>(value >> (8 * i));
+    }
+
+    inline void PutU64(char *at, unsigned long long value) {
+        for (int i = 0; i < 8; i++)
+            at[i] = static_cast<char>(value >> (8 * i));
+    }
+
+    inline uint32_t GetU32(const char *at) {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++)
+            value |= static_cast<uint32_t>(static_cast<unsigned char>(at[i])) << (8 * i);
+        return value;
+    }
+
+    inline unsigned long long GetU64(const char *at) {
+        unsigned long long value = 0;
+        for (int i = 0; i < 8; i++)
+            value |= static_cast<unsigned long long>(static_cast<unsigned char>(at[i])) << (8 * i);
+        return value;
+    }
+
+    inline void AppendU32(std::string &to, uint32_t value) {
+        to.resize(to.size() + 4);
+        PutU32(to.data() + to.size() - 4, value);
+    }
+
+    inline void AppendU64(std::string &to, unsigned long long value) {
+        to.resize(to.size() + 8);
+        PutU64(to.data() + to.size() - 8, value);
+    }
+
+    /**
+     * u32 length, then the bytes.
+     */
+    inline void AppendText(std::string &to, std::string_view text) {
+        AppendU32(to, static_cast<uint32_t>(text.size()));
+        to.append(text);
+    }
+    //endregion
+
+    /**
+     * Reads fields written by the Append* helpers in the order they were written. Every read fails once the data
+     * runs out, texts point into the data.
+     */
+    class ByteReader {
+    public:
+        explicit ByteReader(std::string_view data) : Data(data), Pos(0) {}
+
+        bool U32(uint32_t &out) {
+            if (Data.size() - Pos < 4)
+                return false;
+            out = GetU32(Data.data() + Pos);
+            Pos += 4;
+            return true;
+        }
+
+        bool U64(unsigned long long &out) {
+            if (Data.size() - Pos < 8)
+                return false;
+            out = GetU64(Data.data() + Pos);
+            Pos += 8;
+            return true;
+        }
+
+        bool Text(std::string_view &out) {
+            uint32_t length;
+            if (!U32(length))
+                return false;
+            if (Data.size() - Pos < length) {
+                Pos = Data.size();
+                return false;
+            }
+            out = Data.substr(Pos, length);
+            Pos += length;
+            return true;
+        }
+
+        bool AtEnd() const { return Pos == Data.size(); }
+    private:
+        std::string_view Data;
+        size_t Pos;
+    };
+} // namespace classes::server_side::util
+
+#endif //CHAT2_BYTES_H
@@ -0,0 +1,36 @@
+#include "Crc32.h"
+
+#include <array>
+
+namespace classes::server_side::util {
+    // Slicing-by-4 tables: Tables[0] is the classic byte table, Tables[k] advances a byte through k more zero bytes
+    static const std::array<std::array<uint32_t, 256>, 4> Tables = []() {
+        std::array<std::array<uint32_t, 256>, 4> tables{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int bit = 0; bit < 8; bit++)
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            tables[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; i++)
+            for (size_t k = 1; k < 4; k++)
+                tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+        return tables;
+    }();
+
+    uint32_t Crc32(const void *data, size_t size, uint32_t crc) {
+        auto bytes = static_cast<const uint8_t *>(data);
+        crc = ~crc;
+        while (size >= 4) {
+            crc ^= (uint32_t) bytes[0] | ((uint32_t) bytes[1] << 8) | ((uint32_t) bytes[2] << 16) |
+                   ((uint32_t) bytes[3] << 24);
+            crc = Tables[3][crc & 0xFF] ^ Tables[2][(crc >> 8) & 0xFF] ^ Tables[1][(crc >> 16) & 0xFF] ^
+                  Tables[0][crc >> 24];
+            bytes += 4;
+            size -= 4;
+        }
+        while (size--)
+            crc = Tables[0][(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+} // namespace classes::server_side::util
@@ -0,0 +1,15 @@
+#ifndef CHAT2_CRC32_H
+#define CHAT2_CRC32_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace classes::server_side::util {
+    /**
+     * CRC-32 (IEEE, reflected) for checksumming on-disk records. Pass the previous result as `crc` to continue a
+     * running checksum over several buffers.
+     */
+    uint32_t Crc32(const void *data, size_t size, uint32_t crc = 0);
+} // namespace classes::server_side::util
+
+#endif //CHAT2_CRC32_H
@@ -0,0 +1,163 @@
+#include "FramePool.h"
+#include "SlabPool.h"
+
+#include <cstring>
+#include <new>
+
+namespace classes::server_side::util {
+    //region SizeClasses
+    // Block sizes include the Frame header.
+    constexpr uint8_t HeapClass = 0xFF;
+    constexpr size_t ClassBlockSizes[] = {128, 512, 2048, 8192};
+    constexpr size_t ClassCount = sizeof(ClassBlockSizes) / sizeof(ClassBlockSizes[0]);
+
+    template<size_t Index>
+    using ClassPool = SlabPool<ClassBlockSizes[Index], alignof(Frame)>;
+
+    static void *ClassAllocate(uint8_t sizeClass) {
+        switch (sizeClass) {
+            case 0:
+                return ClassPool<0>::Instance().Allocate();
+            case 1:
+                return ClassPool<1>::Instance().Allocate();
+            case 2:
+                return ClassPool<2>::Instance().Allocate();
+            default:
+                return ClassPool<3>::Instance().Allocate();
+        }
+    }
+
+    static void ClassDeallocate(uint8_t sizeClass, void *block) {
+        switch (sizeClass) {
+            case 0:
+                ClassPool<0>::Instance().Deallocate(block);
+                break;
+            case 1:
+                ClassPool<1>::Instance().Deallocate(block);
+                break;
+            case 2:
+                ClassPool<2>::Instance().Deallocate(block);
+                break;
+            default:
+                ClassPool<3>::Instance().Deallocate(block);
+                break;
+        }
+    }
+    //endregion
+
+    FrameRef::FrameRef() noexcept: Ptr(nullptr) {}
+
+    FrameRef::FrameRef(Frame *frame) noexcept: Ptr(frame) {}
+
+    FrameRef::FrameRef(const FrameRef &other) noexcept: Ptr(other.Ptr) {
+        if (Ptr)
+            Ptr->Refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    FrameRef::FrameRef(FrameRef &&other) noexcept: Ptr(other.Ptr) {
+        other.Ptr = nullptr;
+    }
+
+    FrameRef &FrameRef::operator=(const FrameRef &other) noexcept {
+        if (this != &other) {
+            if (other.Ptr)
+                other.Ptr->Refs.fetch_add(1, std::memory_order_relaxed);
+            Release();
+            Ptr = other.Ptr;
+        }
+        return *this;
+    }
+
+    FrameRef &FrameRef::operator=(FrameRef &&other) noexcept {
+        if (this != &other) {
+            Release();
+            Ptr = other.Ptr;
+            other.Ptr = nullptr;
+        }
+        return *this;
+    }
+
+    FrameRef::~FrameRef() {
+        Release();
+    }
+
+    const char *FrameRef::Data() const {
+        return Ptr ? Ptr->Bytes() : nullptr;
+    }
+
+    size_t FrameRef::Size() const {
+        return Ptr ? Ptr->Length : 0;
+    }
+
+    std::string_view FrameRef::View() const {
+        return Ptr ? std::string_view(Ptr->Bytes(), Ptr->Length) : std::string_view();
+    }
+
+    uint8_t FrameRef::Kind() const {
+        return Ptr ? Ptr->Kind : UntaggedFrame;
+    }
+
+    unsigned long long FrameRef::Room() const {
+        return Ptr ? Ptr->Room : NoRoom;
+    }
+
+    unsigned long long FrameRef::Seq() const {
+        return Ptr ? Ptr->Seq : 0;
+    }
+
+    FrameRef::operator bool() const {
+        return Ptr != nullptr;
+    }
+
+    void FrameRef::Retain(uint32_t count) const {
+        if (Ptr && count > 0)
+            Ptr->Refs.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    FrameRef FrameRef::Claim() const {
+        return FrameRef(Ptr);
+    }
+
+    void FrameRef::Release() noexcept {
+        if (Ptr && Ptr->Refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            FramePool::Free(Ptr);
+        Ptr = nullptr;
+    }
+
+    FrameRef FramePool::FromString(std::string_view bytes, uint8_t kind) {
+        return Build(bytes.size(), [&bytes](char *out) {
+            memcpy(out, bytes.data(), bytes.size());
+        }, kind);
+    }
+
+    Frame *FramePool::Allocate(size_t size) {
+        size_t needed = sizeof(Frame) + size;
+        uint8_t sizeClass = HeapClass;
+        for (size_t i = 0; i < ClassCount; i++) {
+            if (needed <= ClassBlockSizes[i]) {
+                sizeClass = (uint8_t) i;
+                break;
+            }
+        }
+
+        void *block = (sizeClass == HeapClass) ? ::operator new(needed) : ClassAllocate(sizeClass);
+        auto frame = new(block) Frame();
+        frame->Refs.store(1, std::memory_order_relaxed);
+        frame->Length = (uint32_t) size;
+        frame->Capacity = (uint32_t) ((sizeClass == HeapClass ? needed : ClassBlockSizes[sizeClass]) - sizeof(Frame));
+        frame->SizeClass = sizeClass;
+        frame->Kind = UntaggedFrame;
+        frame->Room = NoRoom;
+        frame->Seq = 0;
+        return frame;
+    }
+
+    void FramePool::Free(Frame *frame) noexcept {
+        uint8_t sizeClass = frame->SizeClass;
+        frame->~Frame();
+        if (sizeClass == HeapClass)
+            ::operator delete(frame);
+        else
+            ClassDeallocate(sizeClass, frame);
+    }
+} // namespace classes::server_side::util
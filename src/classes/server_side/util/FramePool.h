@@ -0,0 +1,95 @@
+#ifndef CHAT2_FRAMEPOOL_H
+#define CHAT2_FRAMEPOOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace classes::server_side::util {
+    const uint8_t UntaggedFrame = 0xFF;
+    const unsigned long long NoRoom = ~0ULL;
+
+    struct Frame {
+        std::atomic<uint32_t> Refs;
+        uint32_t Length;
+        uint32_t Capacity;
+        uint8_t SizeClass;
+        uint8_t Kind;
+        unsigned long long Room;
+        unsigned long long Seq;
+
+        char *Bytes() { return reinterpret_cast<char *>(this + 1); }
+        const char *Bytes() const { return reinterpret_cast<const char *>(this + 1); }
+    };
+
+    /**
+     * Shared, immutable reference to a pooled frame. Copying only bumps the reference count; the buffer goes back
+     * to FramePool when the last reference is dropped, typically after the last recipient's send().
+     */
+    class FrameRef {
+    public:
+        FrameRef() noexcept;
+        explicit FrameRef(Frame *frame) noexcept;
+        FrameRef(const FrameRef &other) noexcept;
+        FrameRef(FrameRef &&other) noexcept;
+        FrameRef &operator=(const FrameRef &other) noexcept;
+        FrameRef &operator=(FrameRef &&other) noexcept;
+        ~FrameRef();
+
+        const char *Data() const;
+        size_t Size() const;
+        std::string_view View() const;
+        /**
+         * Tag given when the frame was built, UntaggedFrame if none.
+         */
+        uint8_t Kind() const;
+        /**
+         * Room and log sequence number of a room message, NoRoom for everything else.
+         */
+        unsigned long long Room() const;
+        unsigned long long Seq() const;
+        explicit operator bool() const;
+
+        /**
+         * Pays for `count` references with one atomic add, each to be taken with Claim(). Lets one frame go to many
+         * queues from several threads without every copy hitting the shared counter.
+         */
+        void Retain(uint32_t count) const;
+        FrameRef Claim() const;
+    private:
+        Frame *Ptr;
+
+        void Release() noexcept;
+    };
+
+    /**
+     * Size-classed frame buffers carved from SlabPools, so a frame costs no malloc once the pool is warm.
+     * Frames bigger than the largest class fall back to the heap.
+     */
+    class FramePool {
+    public:
+        static FrameRef FromString(std::string_view bytes, uint8_t kind = UntaggedFrame);
+
+        /**
+         * Allocates a frame of exactly `size` bytes and lets `fill` write it before anyone else can see it.
+         */
+        template<typename F>
+        static FrameRef Build(size_t size, F fill, uint8_t kind = UntaggedFrame, unsigned long long room = NoRoom,
+                              unsigned long long seq = 0) {
+            Frame *frame = Allocate(size);
+            frame->Kind = kind;
+            frame->Room = room;
+            frame->Seq = seq;
+            fill(frame->Bytes());
+            return FrameRef(frame);
+        }
+
+        static void Free(Frame *frame) noexcept;
+    private:
+        static Frame *Allocate(size_t size);
+    };
+} // namespace classes::server_side::util
+
+#endif //CHAT2_FRAMEPOOL_H
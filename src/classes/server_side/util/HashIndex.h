@@ -0,0 +1,169 @@
+#ifndef CHAT2_HASHINDEX_H
+#define CHAT2_HASHINDEX_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace classes::server_side::util {
+    /**
+     * Open-addressing (linear probing) hash map from a 64-bit id to a small value. Keys, values and slot states
+     * live in flat arrays, so a lookup touches one or two cache lines. Not thread safe.
+     */
+    template<typename V>
+    class HashIndex {
+    public:
+        explicit HashIndex(size_t initialCapacity = 16) : Count(0), Tombstones(0) {
+            size_t capacity = 16;
+            while (capacity < initialCapacity)
+                capacity <<= 1;
+            Allocate(capacity);
+        }
+
+        V *Find(unsigned long long key) {
+            size_t slot;
+            return Locate(key, slot) ? &Values[slot] : nullptr;
+        }
+
+        const V *Find(unsigned long long key) const {
+            size_t slot;
+            return Locate(key, slot) ? &Values[slot] : nullptr;
+        }
+
+        bool Contains(unsigned long long key) const {
+            size_t slot;
+            return Locate(key, slot);
+        }
+
+        /**
+         * Inserts or overwrites. Returns true if the key was not present before.
+         */
+        bool Insert(unsigned long long key, V value) {
+            if ((Count + Tombstones + 1) * 10 >= States.size() * 7)
+                Rehash(Count * 2 + 2 >= States.size() ? States.size() * 2 : States.size());
+
+            size_t mask = States.size() - 1;
+            size_t slot = Hash(key) & mask;
+            size_t firstFree = SIZE_MAX;
+            while (States[slot] != SlotState::Empty) {
+                if (States[slot] == SlotState::Full && Keys[slot] == key) {
+                    Values[slot] = std::move(value);
+                    return false;
+                }
+                if (States[slot] == SlotState::Deleted && firstFree == SIZE_MAX)
+                    firstFree = slot;
+                slot = (slot + 1) & mask;
+            }
+            if (firstFree != SIZE_MAX) {
+                slot = firstFree;
+                Tombstones--;
+            }
+            States[slot] = SlotState::Full;
+            Keys[slot] = key;
+            Values[slot] = std::move(value);
+            Count++;
+            return true;
+        }
+
+        bool Erase(unsigned long long key) {
+            size_t slot;
+            if (!Locate(key, slot))
+                return false;
+            States[slot] = SlotState::Deleted;
+            Values[slot] = V();
+            Count--;
+            Tombstones++;
+            return true;
+        }
+
+        /**
+         * Grows the table so count keys fit without another rehash.
+         */
+        void Reserve(size_t count) {
+            size_t capacity = States.size();
+            while ((count + 1) * 10 >= capacity * 7)
+                capacity <<= 1;
+            if (capacity != States.size())
+                Rehash(capacity);
+        }
+
+        void Clear() {
+            Count = 0;
+            Tombstones = 0;
+            Allocate(16);
+        }
+
+        size_t Size() const {
+            return Count;
+        }
+
+        template<typename F>
+        void ForEach(F fn) {
+            for (size_t i = 0; i < States.size(); i++)
+                if (States[i] == SlotState::Full)
+                    fn(Keys[i], Values[i]);
+        }
+    private:
+        enum class SlotState : uint8_t {
+            Empty,
+            Full,
+            Deleted
+        };
+
+        std::vector<SlotState> States;
+        std::vector<unsigned long long> Keys;
+        std::vector<V> Values;
+        size_t Count;
+        size_t Tombstones;
+
+        // splitmix64 finalizer; ids are handed out sequentially and need spreading.
+        static size_t Hash(unsigned long long key) {
+            key ^= key >> 30;
+            key *= 0xbf58476d1ce4e5b9ULL;
+            key ^= key >> 27;
+            key *= 0x94d049bb133111ebULL;
+            key ^= key >> 31;
+            return (size_t) key;
+        }
+
+        bool Locate(unsigned long long key, size_t &slot) const {
+            size_t mask = States.size() - 1;
+            slot = Hash(key) & mask;
+            while (States[slot] != SlotState::Empty) {
+                if (States[slot] == SlotState::Full && Keys[slot] == key)
+                    return true;
+                slot = (slot + 1) & mask;
+            }
+            return false;
+        }
+
+        void Allocate(size_t capacity) {
+            States.assign(capacity, SlotState::Empty);
+            Keys.assign(capacity, 0);
+            Values.assign(capacity, V());
+        }
+
+        void Rehash(size_t capacity) {
+            auto oldStates = std::move(States);
+            auto oldKeys = std::move(Keys);
+            auto oldValues = std::move(Values);
+            Allocate(capacity);
+            Count = 0;
+            Tombstones = 0;
+            size_t mask = capacity - 1;
+            for (size_t i = 0; i < oldStates.size(); i++) {
+                if (oldStates[i] != SlotState::Full)
+                    continue;
+                size_t slot = Hash(oldKeys[i]) & mask;
+                while (States[slot] != SlotState::Empty)
+                    slot = (slot + 1) & mask;
+                States[slot] = SlotState::Full;
+                Keys[slot] = oldKeys[i];
+                Values[slot] = std::move(oldValues[i]);
+                Count++;
+            }
+        }
+    };
+} // namespace classes::server_side::util
+
+#endif //CHAT2_HASHINDEX_H
@@ -0,0 +1,146 @@
+#ifndef CHAT2_MEMBERSET_H
+#define CHAT2_MEMBERSET_H
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <numeric>
+#include <cstdint>
+#include <cstddef>
+
+#include "HashIndex.h"
+
+namespace classes::server_side::util {
+    /**
+     * Set of room members keyed by a 64-bit id. Keys and values sit in two dense arrays, so fan-out iterates
+     * contiguous memory in either mode.
+     * Small sets keep the arrays sorted by key and binary search them. Past SmallLimit members a HashIndex from key
+     * to array position is built and removal swaps the last member into the hole, keeping contains/insert/remove
+     * O(1). The index is dropped again once the set shrinks below half of SmallLimit. Not thread safe.
+     */
+    template<typename T>
+    class MemberSet {
+    public:
+        static constexpr size_t SmallLimit = 64;
+
+        typedef typename std::vector<T>::const_iterator const_iterator;
+
+        bool Contains(unsigned long long key) const {
+            return Position(key) != SIZE_MAX;
+        }
+
+        T *Find(unsigned long long key) {
+            auto pos = Position(key);
+            return pos == SIZE_MAX ? nullptr : &Values[pos];
+        }
+
+        /**
+         * Returns false, and leaves the set unchanged, if the key is already a member.
+         */
+        bool Insert(unsigned long long key, T value) {
+            if (Index) {
+                if (Index->Contains(key))
+                    return false;
+                Index->Insert(key, (uint32_t) Keys.size());
+                Keys.push_back(key);
+                Values.push_back(std::move(value));
+                return true;
+            }
+
+            auto it = std::lower_bound(Keys.begin(), Keys.end(), key);
+            if (it != Keys.end() && *it == key)
+                return false;
+            auto pos = it - Keys.begin();
+            Keys.insert(it, key);
+            Values.insert(Values.begin() + pos, std::move(value));
+            if (Keys.size() > SmallLimit)
+                BuildIndex();
+            return true;
+        }
+
+        bool Erase(unsigned long long key) {
+            auto pos = Position(key);
+            if (pos == SIZE_MAX)
+                return false;
+
+            if (!Index) {
+                Keys.erase(Keys.begin() + pos);
+                Values.erase(Values.begin() + pos);
+                return true;
+            }
+
+            Index->Erase(key);
+            size_t last = Keys.size() - 1;
+            if (pos != last) {
+                Keys[pos] = Keys[last];
+                Values[pos] = std::move(Values[last]);
+                Index->Insert(Keys[pos], (uint32_t) pos);
+            }
+            Keys.pop_back();
+            Values.pop_back();
+            if (Keys.size() < SmallLimit / 2)
+                DropIndex();
+            return true;
+        }
+
+        void Clear() {
+            Keys.clear();
+            Values.clear();
+            Index.reset();
+        }
+
+        size_t Size() const {
+            return Keys.size();
+        }
+
+        bool Empty() const {
+            return Keys.empty();
+        }
+
+        const_iterator begin() const {
+            return Values.begin();
+        }
+
+        const_iterator end() const {
+            return Values.end();
+        }
+    private:
+        std::vector<unsigned long long> Keys;
+        std::vector<T> Values;
+        std::unique_ptr<HashIndex<uint32_t>> Index;
+
+        size_t Position(unsigned long long key) const {
+            if (Index) {
+                auto pos = Index->Find(key);
+                return pos ? *pos : SIZE_MAX;
+            }
+            auto it = std::lower_bound(Keys.begin(), Keys.end(), key);
+            return (it != Keys.end() && *it == key) ? size_t(it - Keys.begin()) : SIZE_MAX;
+        }
+
+        void BuildIndex() {
+            Index = std::make_unique<HashIndex<uint32_t>>(Keys.size() * 2);
+            for (size_t i = 0; i < Keys.size(); i++)
+                Index->Insert(Keys[i], (uint32_t) i);
+        }
+
+        void DropIndex() {
+            std::vector<size_t> order(Keys.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [this](size_t a, size_t b) { return Keys[a] < Keys[b]; });
+            std::vector<unsigned long long> keys;
+            std::vector<T> values;
+            keys.reserve(order.size());
+            values.reserve(order.size());
+            for (auto i: order) {
+                keys.push_back(Keys[i]);
+                values.push_back(std::move(Values[i]));
+            }
+            Keys = std::move(keys);
+            Values = std::move(values);
+            Index.reset();
+        }
+    };
+} // namespace classes::server_side::util
+
+#endif //CHAT2_MEMBERSET_H
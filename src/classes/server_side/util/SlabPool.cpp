@@ -0,0 +1,24 @@
+#include "SlabPool.h"
+
+namespace classes::server_side::util {
+    std::mutex PoolRegistry::m_Pools = {};
+
+    std::vector<std::function<PoolStats()>> &PoolRegistry::Pools() {
+        static std::vector<std::function<PoolStats()>> pools;
+        return pools;
+    }
+
+    void PoolRegistry::Register(std::function<PoolStats()> statsFn) {
+        std::lock_guard<std::mutex> guard(m_Pools);
+        Pools().push_back(std::move(statsFn));
+    }
+
+    std::vector<PoolStats> PoolRegistry::Snapshot() {
+        std::lock_guard<std::mutex> guard(m_Pools);
+        std::vector<PoolStats> res;
+        res.reserve(Pools().size());
+        for (auto &statsFn: Pools())
+            res.push_back(statsFn());
+        return res;
+    }
+} // namespace classes::server_side::util
@@ -0,0 +1,186 @@
+#ifndef CHAT2_SLABPOOL_H
+#define CHAT2_SLABPOOL_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <cstddef>
+#include <new>
+
+namespace classes::server_side::util {
+    struct PoolStats {
+        size_t BlockSize;
+        size_t Slabs;
+        size_t Capacity;
+        size_t InUse;
+    };
+
+    /**
+     * Every SlabPool registers here on first use so occupancy can be reported without knowing the pool types.
+     */
+    class PoolRegistry {
+    public:
+        static void Register(std::function<PoolStats()> statsFn);
+        static std::vector<PoolStats> Snapshot();
+    private:
+        static std::mutex m_Pools;
+        static std::vector<std::function<PoolStats()>> &Pools();
+    };
+
+    /**
+     * Fixed-size block allocator. Blocks are carved from slabs that are never returned to the system, freed
+     * blocks are recycled. Each thread keeps a small cache of free blocks, so the shared free list and its lock
+     * are only touched once per CacheBatch allocations.
+     */
+    template<size_t Size, size_t Align>
+    class SlabPool {
+    public:
+        static constexpr size_t BlockAlign = Align < alignof(void *) ? alignof(void *) : Align;
+        static constexpr size_t BlockSize = ((Size < sizeof(void *) ? sizeof(void *) : Size) + BlockAlign - 1) /
+                                            BlockAlign * BlockAlign;
+        static constexpr size_t BlocksPerSlab = 64;
+        static constexpr size_t CacheBatch = 16;
+        static constexpr size_t CacheLimit = 2 * CacheBatch;
+
+        static SlabPool &Instance() {
+            static SlabPool pool;
+            return pool;
+        }
+
+        void *Allocate() {
+            auto &cache = LocalCache();
+            if (!cache.Head)
+                Refill(cache);
+            FreeBlock *block = cache.Head;
+            cache.Head = block->Next;
+            cache.Count--;
+            InUse.fetch_add(1, std::memory_order_relaxed);
+            return block;
+        }
+
+        void Deallocate(void *ptr) {
+            auto &cache = LocalCache();
+            auto block = static_cast<FreeBlock *>(ptr);
+            block->Next = cache.Head;
+            cache.Head = block;
+            cache.Count++;
+            InUse.fetch_sub(1, std::memory_order_relaxed);
+            if (cache.Count > CacheLimit)
+                Spill(cache, CacheBatch);
+        }
+
+        PoolStats Stats() {
+            std::lock_guard<std::mutex> guard(m_Free);
+            return PoolStats{BlockSize, Slabs.size(), Slabs.size() * BlocksPerSlab, InUse.load()};
+        }
+    private:
+        struct FreeBlock {
+            FreeBlock *Next;
+        };
+
+        struct ThreadCache {
+            FreeBlock *Head = nullptr;
+            size_t Count = 0;
+
+            ~ThreadCache() {
+                // Hand the blocks back so a recycled thread id does not strand them.
+                if (Count)
+                    Instance().Spill(*this, Count);
+            }
+        };
+
+        struct SlabDeleter {
+            void operator()(unsigned char *slab) const {
+                ::operator delete(slab, std::align_val_t(BlockAlign));
+            }
+        };
+
+        std::mutex m_Free;
+        FreeBlock *FreeHead;
+        std::vector<std::unique_ptr<unsigned char, SlabDeleter>> Slabs;
+        std::atomic<size_t> InUse;
+
+        SlabPool() : FreeHead(nullptr), InUse(0) {
+            PoolRegistry::Register([this]() { return Stats(); });
+        }
+
+        static ThreadCache &LocalCache() {
+            thread_local ThreadCache cache;
+            return cache;
+        }
+
+        void Refill(ThreadCache &cache) {
+            std::lock_guard<std::mutex> guard(m_Free);
+            if (!FreeHead) {
+                auto slab = static_cast<unsigned char *>(::operator new(BlockSize * BlocksPerSlab,
+                                                                        std::align_val_t(BlockAlign)));
+                Slabs.emplace_back(slab);
+                for (size_t i = 0; i < BlocksPerSlab; i++) {
+                    auto block = reinterpret_cast<FreeBlock *>(slab + i * BlockSize);
+                    block->Next = FreeHead;
+                    FreeHead = block;
+                }
+            }
+            while (FreeHead && cache.Count < CacheBatch) {
+                FreeBlock *block = FreeHead;
+                FreeHead = block->Next;
+                block->Next = cache.Head;
+                cache.Head = block;
+                cache.Count++;
+            }
+        }
+
+        void Spill(ThreadCache &cache, size_t count) {
+            std::lock_guard<std::mutex> guard(m_Free);
+            while (count-- && cache.Head) {
+                FreeBlock *block = cache.Head;
+                cache.Head = block->Next;
+                cache.Count--;
+                block->Next = FreeHead;
+                FreeHead = block;
+            }
+        }
+    };
+
+    /**
+     * Standard allocator over SlabPool, for allocate_shared and containers. Single-object requests come from the
+     * pool matching the (rebound) type's size, anything larger goes to the global heap.
+     */
+    template<typename T>
+    class PoolAllocator {
+    public:
+        typedef T value_type;
+
+        PoolAllocator() noexcept = default;
+        template<typename U>
+        PoolAllocator(const PoolAllocator<U> &) noexcept {}
+
+        T *allocate(size_t n) {
+            if (n == 1)
+                return static_cast<T *>(SlabPool<sizeof(T), alignof(T)>::Instance().Allocate());
+            return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+        }
+
+        void deallocate(T *ptr, size_t n) noexcept {
+            if (n == 1)
+                SlabPool<sizeof(T), alignof(T)>::Instance().Deallocate(ptr);
+            else
+                ::operator delete(ptr, std::align_val_t(alignof(T)));
+        }
+
+        template<typename U>
+        bool operator==(const PoolAllocator<U> &) const noexcept { return true; }
+        template<typename U>
+        bool operator!=(const PoolAllocator<U> &) const noexcept { return false; }
+    };
+
+    template<typename T, typename... Args>
+    std::shared_ptr<T> MakePooled(Args &&... args) {
+        return std::allocate_shared<T>(PoolAllocator<T>(), std::forward<Args>(args)...);
+    }
+} // namespace classes::server_side::util
+
+#endif //CHAT2_SLABPOOL_H
@@ -0,0 +1,117 @@
+#ifndef CHAT2_SLOTMAP_H
+#define CHAT2_SLOTMAP_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace classes::server_side::util {
+    struct SlotHandle {
+        uint32_t Index = UINT32_MAX;
+        uint32_t Generation = 0;
+
+        bool Valid() const { return Index != UINT32_MAX; }
+        bool operator==(const SlotHandle &other) const {
+            return Index == other.Index && Generation == other.Generation;
+        }
+    };
+
+    /**
+     * Chunked object storage with stable addresses. Elements never move once emplaced, erasing is O(1) and the
+     * freed slot is reused by the next Emplace(). A handle carries the slot's generation, so a handle to an erased
+     * element resolves to nullptr instead of to whatever took its place. Not thread safe.
+     */
+    template<typename T, size_t ChunkSize = 1024>
+    class SlotMap {
+    public:
+        SlotMap() : FreeHead(UINT32_MAX), Count(0) {}
+        SlotMap(const SlotMap &) = delete;
+        SlotMap &operator=(const SlotMap &) = delete;
+
+        ~SlotMap() {
+            ForEach([](SlotHandle, T &value) { value.~T(); });
+        }
+
+        template<typename... Args>
+        SlotHandle Emplace(Args &&... args) {
+            if (FreeHead == UINT32_MAX)
+                Grow();
+            uint32_t index = FreeHead;
+            Slot &slot = At(index);
+            new(slot.Storage) T(std::forward<Args>(args)...);
+            FreeHead = slot.NextFree;
+            slot.Occupied = true;
+            Count++;
+            return SlotHandle{index, slot.Generation};
+        }
+
+        T *Get(SlotHandle handle) {
+            if (!handle.Valid() || handle.Index >= Chunks.size() * ChunkSize)
+                return nullptr;
+            Slot &slot = At(handle.Index);
+            if (!slot.Occupied || slot.Generation != handle.Generation)
+                return nullptr;
+            return slot.Value();
+        }
+
+        bool Erase(SlotHandle handle) {
+            T *value = Get(handle);
+            if (!value)
+                return false;
+            value->~T();
+            Slot &slot = At(handle.Index);
+            slot.Occupied = false;
+            slot.Generation++;
+            slot.NextFree = FreeHead;
+            FreeHead = handle.Index;
+            Count--;
+            return true;
+        }
+
+        size_t Size() const {
+            return Count;
+        }
+
+        template<typename F>
+        void ForEach(F fn) {
+            for (size_t c = 0; c < Chunks.size(); c++)
+                for (size_t i = 0; i < ChunkSize; i++) {
+                    Slot &slot = Chunks[c][i];
+                    if (slot.Occupied)
+                        fn(SlotHandle{(uint32_t) (c * ChunkSize + i), slot.Generation}, *slot.Value());
+                }
+        }
+    private:
+        struct Slot {
+            alignas(T) unsigned char Storage[sizeof(T)];
+            uint32_t Generation = 0;
+            uint32_t NextFree = UINT32_MAX;
+            bool Occupied = false;
+
+            T *Value() { return std::launder(reinterpret_cast<T *>(Storage)); }
+        };
+
+        std::vector<std::unique_ptr<Slot[]>> Chunks;
+        uint32_t FreeHead;
+        size_t Count;
+
+        Slot &At(uint32_t index) {
+            return Chunks[index / ChunkSize][index % ChunkSize];
+        }
+
+        void Grow() {
+            auto base = (uint32_t) (Chunks.size() * ChunkSize);
+            Chunks.emplace_back(new Slot[ChunkSize]);
+            auto &chunk = Chunks.back();
+            // Thread the new slots onto the free list in index order
+            for (size_t i = 0; i < ChunkSize; i++)
+                chunk[i].NextFree = (i + 1 < ChunkSize) ? base + (uint32_t) i + 1 : FreeHead;
+            FreeHead = base;
+        }
+    };
+} // namespace classes::server_side::util
+
+#endif //CHAT2_SLOTMAP_H
@@ -0,0 +1,103 @@
+#include "StringTable.h"
+
+#include <cstring>
+#include <functional>
+
+namespace classes::server_side::util {
+    Symbol Symbol::Intern(std::string_view text) {
+        return StringTable::Global().Intern(text);
+    }
+
+    std::string_view Symbol::View() const {
+        return StringTable::Global().Resolve(*this);
+    }
+
+    std::string Symbol::Str() const {
+        return std::string(View());
+    }
+
+    std::ostream &operator<<(std::ostream &os, Symbol symbol) {
+        return os << symbol.View();
+    }
+
+    StringTable &StringTable::Global() {
+        static StringTable table;
+        return table;
+    }
+
+    StringTable::StringTable() : Pages(new std::atomic<Entry *>[PageCount]), NextId(1) {
+        for (size_t i = 0; i < PageCount; i++)
+            Pages[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    StringTable::~StringTable() {
+        for (size_t i = 0; i < PageCount; i++)
+            delete[] Pages[i].load(std::memory_order_relaxed);
+    }
+
+    Symbol StringTable::Intern(std::string_view text) {
+        if (text.empty())
+            return {};
+
+        auto &shard = Shards[std::hash<std::string_view>()(text) % ShardCount];
+        { //Critical Section
+            std::lock_guard<std::mutex> guard(shard.m_Shard);
+            auto it = shard.Ids.find(text);
+            if (it != shard.Ids.end())
+                return Symbol{it->second};
+
+            auto stored = Store(shard, text);
+            auto id = NextId.fetch_add(1, std::memory_order_relaxed);
+            Slot(id) = Entry{stored, (uint32_t) text.size()};
+            shard.Ids.emplace(std::string_view(stored, text.size()), id);
+            return Symbol{id};
+        }
+    }
+
+    std::string_view StringTable::Resolve(Symbol symbol) const {
+        if (symbol.Empty())
+            return {};
+        auto page = Pages[symbol.Id >> PageBits].load(std::memory_order_acquire);
+        if (!page)
+            return {};
+        auto &entry = page[symbol.Id & (PageSize - 1)];
+        return {entry.Data, entry.Length};
+    }
+
+    size_t StringTable::Size() const {
+        return NextId.load(std::memory_order_relaxed) - 1;
+    }
+
+    const char *StringTable::Store(Shard &shard, std::string_view text) {
+        char *stored;
+        if (text.size() > ArenaBlockSize / 4) {
+            // Oversized texts get a block of their own, the current block keeps filling
+            shard.Blocks.emplace_back(new char[text.size()]);
+            stored = shard.Blocks.back().get();
+        } else {
+            if (!shard.Current || shard.CurrentUsed + text.size() > ArenaBlockSize) {
+                shard.Blocks.emplace_back(new char[ArenaBlockSize]);
+                shard.Current = shard.Blocks.back().get();
+                shard.CurrentUsed = 0;
+            }
+            stored = shard.Current + shard.CurrentUsed;
+            shard.CurrentUsed += text.size();
+        }
+        memcpy(stored, text.data(), text.size());
+        return stored;
+    }
+
+    StringTable::Entry &StringTable::Slot(uint32_t id) {
+        auto &pageSlot = Pages[id >> PageBits];
+        auto page = pageSlot.load(std::memory_order_acquire);
+        if (!page) {
+            std::lock_guard<std::mutex> guard(m_Pages);
+            page = pageSlot.load(std::memory_order_relaxed);
+            if (!page) {
+                page = new Entry[PageSize]();
+                pageSlot.store(page, std::memory_order_release);
+            }
+        }
+        return page[id & (PageSize - 1)];
+    }
+} // namespace classes::server_side::util
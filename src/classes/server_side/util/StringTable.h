@@ -0,0 +1,79 @@
+#ifndef CHAT2_STRINGTABLE_H
+#define CHAT2_STRINGTABLE_H
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <ostream>
+#include <cstdint>
+
+namespace classes::server_side::util {
+    /**
+     * Compact handle to an interned string. Equal texts always get the same id, so comparing symbols is an integer
+     * compare. Id 0 is the empty string.
+     */
+    struct Symbol {
+        uint32_t Id = 0;
+
+        static Symbol Intern(std::string_view text);
+
+        std::string_view View() const;
+        std::string Str() const;
+        bool Empty() const { return Id == 0; }
+
+        bool operator==(const Symbol &other) const { return Id == other.Id; }
+        bool operator!=(const Symbol &other) const { return Id != other.Id; }
+    };
+
+    std::ostream &operator<<(std::ostream &os, Symbol symbol);
+
+    /**
+     * Process-wide interning table. Interning is sharded by hash, each shard with its own lock and text arena.
+     * Resolving an id takes no lock: ids index a two-level directory whose pages are only ever added, and texts
+     * never move once stored.
+     */
+    class StringTable {
+    public:
+        static StringTable &Global();
+
+        Symbol Intern(std::string_view text);
+        std::string_view Resolve(Symbol symbol) const;
+        size_t Size() const;
+    private:
+        static constexpr size_t ShardCount = 16;
+        static constexpr size_t PageBits = 16;
+        static constexpr size_t PageSize = size_t(1) << PageBits;
+        static constexpr size_t PageCount = size_t(1) << (32 - PageBits);
+        static constexpr size_t ArenaBlockSize = 64 * 1024;
+
+        struct Entry {
+            const char *Data;
+            uint32_t Length;
+        };
+
+        struct Shard {
+            std::mutex m_Shard;
+            std::unordered_map<std::string_view, uint32_t> Ids;
+            std::vector<std::unique_ptr<char[]>> Blocks;
+            char *Current = nullptr;
+            size_t CurrentUsed = 0;
+        };
+
+        Shard Shards[ShardCount];
+        std::unique_ptr<std::atomic<Entry *>[]> Pages;
+        std::mutex m_Pages;
+        std::atomic<uint32_t> NextId;
+
+        StringTable();
+        ~StringTable();
+
+        static const char *Store(Shard &shard, std::string_view text);
+        Entry &Slot(uint32_t id);
+    };
+} // namespace classes::server_side::util
+
+#endif //CHAT2_STRINGTABLE_H
@@ -0,0 +1,62 @@
+// BenchClientIndex.cpp
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "BenchClientIndex.h"
+#include "../classes/server_side/util/HashIndex.h"
+
+using namespace std;
+using namespace classes::server_side;
+
+namespace testing::BenchClientIndex {
+    struct FakeClient {
+        unsigned long long ClientID;
+    };
+
+    const size_t LookupCount = 1000000;
+    const size_t LinearScanLimit = 100000;
+
+    void StartBench() {
+        mt19937_64 rng(42);
+        for (size_t n = 1000; n <= 10000000; n *= 10) {
+            vector<FakeClient> clients(n);
+            util::HashIndex<FakeClient*> index;
+            for (size_t i = 0; i < n; i++) {
+                clients[i].ClientID = i;
+                index.Insert(i, &clients[i]);
+            }
+
+            vector<unsigned long long> keys(LookupCount);
+            uniform_int_distribution<unsigned long long> pick(0, n - 1);
+            for (auto &key: keys)
+                key = pick(rng);
+
+            unsigned long long hits = 0;
+            auto start = chrono::steady_clock::now();
+            for (auto key: keys) {
+                auto found = index.Find(key);
+                hits += (found && (*found)->ClientID == key);
+            }
+            chrono::duration<double, nano> indexTime = chrono::steady_clock::now() - start;
+            cout << "clients=" << n
+                 << "\tindex: " << indexTime.count() / LookupCount << " ns/lookup (hits=" << hits << ")";
+
+            if (n <= LinearScanLimit) {
+                // The old scan is O(n); sample fewer keys so large n still finishes.
+                size_t scanCount = LookupCount / (n / 1000);
+                hits = 0;
+                start = chrono::steady_clock::now();
+                for (size_t i = 0; i < scanCount; i++)
+                    for (auto &c: clients)
+                        if (c.ClientID == keys[i]) {
+                            hits++;
+                            break;
+                        }
+                chrono::duration<double, nano> scanTime = chrono::steady_clock::now() - start;
+                cout << "\tlinear scan: " << scanTime.count() / scanCount << " ns/lookup (hits=" << hits << ")";
+            }
+            cout << endl;
+        }
+    }
+}
@@ -0,0 +1,13 @@
+// BenchClientIndex.h
+#ifndef CHAT2_BENCHCLIENTINDEX_H
+#define CHAT2_BENCHCLIENTINDEX_H
+
+namespace testing::BenchClientIndex {
+    /**
+     * Compares ClientID lookups through util::HashIndex with the linear scan over Server::Clients it replaced,
+     * for 10^3 to 10^7 clients.
+     */
+    void StartBench();
+}
+
+#endif //CHAT2_BENCHCLIENTINDEX_H
@@ -0,0 +1,80 @@
+// BenchFanout.cpp
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include "BenchFanout.h"
+#include "../classes/server_side/ClientTable.h"
+#include "../classes/server_side/OutboundQueue.h"
+#include "../classes/server_side/RegisteredClient.h"
+
+using namespace std;
+using namespace classes::server_side;
+
+namespace testing::BenchFanout {
+    // Stand-in for the client record before the split: hot and cold fields side by side, one heap block each.
+    struct FatClient {
+        unsigned long long ClientID;
+        string DisplayName;
+        string LoginKey;
+        unordered_set<unsigned long long> JoinedRooms;
+        bool IsConnected;
+        unique_ptr<OutboundQueue> Outbound;
+    };
+
+    const size_t Rounds = 20;
+
+    void StartBench() {
+        mt19937_64 rng(42);
+        for (size_t n = 100; n <= 100000; n *= 10) {
+            vector<shared_ptr<FatClient>> fat;
+            vector<shared_ptr<RegisteredClient>> records;
+            vector<unique_ptr<char[]>> noise;
+            ClientTable table;
+            vector<uint32_t> slots;
+            for (size_t i = 0; i < n; i++) {
+                auto c = make_shared<FatClient>();
+                c->ClientID = i;
+                c->DisplayName = "Member number " + to_string(i);
+                c->IsConnected = true;
+                c->Outbound = make_unique<OutboundQueue>();
+                fat.push_back(c);
+                // Interleave unrelated allocations, as a long-running server would
+                noise.emplace_back(new char[rng() % 512 + 64]);
+
+                records.push_back(RegisteredClient::Create("Member"));
+                slots.push_back(table.Add(records.back().get()));
+                table.SetConnected(slots.back(), true);
+            }
+            shuffle(fat.begin(), fat.end(), rng);
+            shuffle(slots.begin(), slots.end(), rng);
+
+            auto frame = util::FramePool::FromString("2 0 0 0 NULL 0 0 1 0 benchmark message");
+            auto start = chrono::steady_clock::now();
+            for (size_t r = 0; r < Rounds; r++) {
+                for (auto &c: fat)
+                    if (c->IsConnected)
+                        c->Outbound->Push(frame);
+                for (auto &c: fat)
+                    c->Outbound->Pop();
+            }
+            chrono::duration<double, nano> fatTime = chrono::steady_clock::now() - start;
+
+            start = chrono::steady_clock::now();
+            for (size_t r = 0; r < Rounds; r++) {
+                for (auto slot: slots)
+                    if (table.Connected(slot))
+                        table.Push(slot, frame);
+                for (auto slot: slots)
+                    table.Queue(slot)->Pop();
+            }
+            chrono::duration<double, nano> hotTime = chrono::steady_clock::now() - start;
+
+            cout << "members=" << n
+                 << "\tshared_ptr records: " << fatTime.count() / (Rounds * n) << " ns/delivery"
+                 << "\thot table: " << hotTime.count() / (Rounds * n) << " ns/delivery" << endl;
+        }
+    }
+}
@@ -0,0 +1,13 @@
+// BenchFanout.h
+#ifndef CHAT2_BENCHFANOUT_H
+#define CHAT2_BENCHFANOUT_H
+
+namespace testing::BenchFanout {
+    /**
+     * Time per delivered message when fanning one frame out to a room, reaching members through the ClientTable
+     * slots versus through scattered shared_ptr<RegisteredClient>-like records, for 10^2 to 10^5 members.
+     */
+    void StartBench();
+}
+
+#endif //CHAT2_BENCHFANOUT_H
@@ -0,0 +1,24 @@
+// BenchMain.cpp
+#include <iostream>
+#include <string>
+#include "BenchClientIndex.h"
+#include "BenchFanout.h"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+    string which = argc > 1 ? argv[1] : "";
+    if (!which.empty() && which != "clientindex" && which != "fanout") {
+        cerr << "Usage: " << argv[0] << " [clientindex|fanout]" << endl;
+        return 1;
+    }
+    if (which.empty() || which == "clientindex") {
+        cout << "== ClientID index" << endl;
+        testing::BenchClientIndex::StartBench();
+    }
+    if (which.empty() || which == "fanout") {
+        cout << "== Room fanout" << endl;
+        testing::BenchFanout::StartBench();
+    }
+    return 0;
+}